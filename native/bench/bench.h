@@ -0,0 +1,121 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+// mirrors native/src/websocket.h
+#define WSM_OK			0
+#define WSM_PORT_OPEN	10
+#define WSM_PORT_CLOSE	11
+#define WSM_SET_CONFIG	20
+#define WSM_SET_RX_FLOW 22
+#define WSM_SET_SIGNALS 30
+#define WSM_GET_SIGNALS 31
+#define WSM_START_BREAK 40
+#define WSM_END_BREAK	41
+#define WSM_DATA		50
+#define WSM_RX_CREDIT	52
+#define WSM_ERROR		128
+
+// size of a WebSocket request header (opcode + sequence number)
+#define BENCH_WS_HEADER	 3
+// biggest WebSocket frame the benchmark receives
+#define BENCH_WS_MAX	 (1024 * 1024)
+// how long to wait for a response
+#define BENCH_TIMEOUT_MS 5000
+
+typedef struct {
+	double *values;
+	uint32_t len;
+	uint32_t size;
+} bench_samples_t;
+
+typedef struct {
+	pid_t pid;
+	int in_fd;	// host's stdin
+	int out_fd; // host's stdout
+	uint32_t next_id;
+	char *buf;
+	uint32_t buf_size;
+} bench_host_t;
+
+typedef struct bench_ws bench_ws_t;
+// called from the connection's reader thread for every unsolicited WSM_DATA frame
+typedef void (*bench_ws_data_cb_t)(bench_ws_t *ws, const uint8_t *data, uint32_t len);
+
+struct bench_ws {
+	int fd;
+	pthread_t thread;
+	pthread_mutex_t send_mutex; // one frame at a time
+	pthread_mutex_t mutex;		// protects the fields below
+	pthread_cond_t cond;		// signalled when a response arrives
+	uint16_t next_seq;
+	uint32_t in_flight;	   // requests without a response yet
+	uint8_t last_opcode;   // opcode of the last response
+	uint16_t last_seq;	   // sequence number of the last response
+	uint32_t last_credits; // TX credits reported by the last WSM_DATA response
+	bool closed;
+	bench_ws_data_cb_t on_data;
+	void *arg;
+};
+
+typedef struct {
+	int master_fd;
+	char name[64];
+} bench_pty_t;
+
+typedef struct {
+	const char *host_path;
+	int ws_port;
+	uint32_t duration_ms;
+	uint32_t *chunks;
+	int chunks_len;
+	uint32_t *ports;
+	int ports_len;
+	uint32_t rx_window;
+	uint32_t interval_us;
+	uint32_t ops;
+} bench_options_t;
+
+// bench_util.c
+uint64_t bench_time_us();
+void bench_sleep_us(uint64_t us);
+void bench_samples_add(bench_samples_t *samples, double value);
+double bench_samples_percentile(bench_samples_t *samples, double percentile);
+void bench_samples_free(bench_samples_t *samples);
+void bench_output_begin(FILE *out);
+void bench_output_record_begin(FILE *out, const char *fmt, ...);
+void bench_output_latency(FILE *out, const char *key, bench_samples_t *samples);
+void bench_output_record_end(FILE *out);
+void bench_output_end(FILE *out);
+
+// bench_host.c
+bool bench_host_start(bench_host_t *host, const char *path);
+void bench_host_stop(bench_host_t *host);
+bool bench_host_request(bench_host_t *host, const char *action, const char *extra, char *data, uint32_t data_size);
+
+// bench_ws.c
+bool bench_ws_connect(bench_ws_t *ws, int port, bench_ws_data_cb_t on_data, void *arg);
+void bench_ws_close(bench_ws_t *ws);
+bool bench_ws_send(bench_ws_t *ws, uint8_t opcode, const void *data, uint32_t len, uint16_t *seq);
+bool bench_ws_wait(bench_ws_t *ws, uint32_t max_in_flight);
+bool bench_ws_request(bench_ws_t *ws, uint8_t opcode, const void *data, uint32_t len);
+
+// bench_pty.c
+bool bench_pty_open(bench_pty_t *pty);
+void bench_pty_close(bench_pty_t *pty);
+
+// bench_port.c
+bool bench_port_open(bench_host_t *host, bench_ws_t *ws, bench_pty_t *pty, const bench_options_t *options);
+void bench_port_close(bench_ws_t *ws, bench_pty_t *pty);
+
+// bench_data.c
+int bench_data(const bench_options_t *options);
+
+// bench_control.c
+int bench_control(const bench_options_t *options);
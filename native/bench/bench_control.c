@@ -0,0 +1,112 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "bench.h"
+
+#include <string.h>
+
+typedef struct {
+	const char *name;
+	uint8_t opcode;
+	const void *data;
+	uint32_t len;
+} bench_control_op_t;
+
+static const uint8_t bench_signals[] = {1, 1};							  // DTR, RTS
+static const uint8_t bench_config[]	 = {0x00, 0xC2, 0x01, 0x00, 8, 0, 1}; // 115200 8N1
+
+// PTYs have no modem lines - the signal requests measure the error path of the host
+static const bench_control_op_t bench_control_ops[] = {
+	{"SET_SIGNALS", WSM_SET_SIGNALS, bench_signals, sizeof(bench_signals)},
+	{"GET_SIGNALS", WSM_GET_SIGNALS, NULL, 0},
+	{"SET_CONFIG", WSM_SET_CONFIG, bench_config, sizeof(bench_config)},
+	{"START_BREAK", WSM_START_BREAK, NULL, 0},
+	{"END_BREAK", WSM_END_BREAK, NULL, 0},
+};
+
+static void bench_control_output(const char *op, uint32_t ops, uint32_t errors, double elapsed, bench_samples_t *rtt) {
+	bench_output_record_begin(
+		stdout,
+		"\"scenario\": \"control\", \"op\": \"%s\", \"ops\": %u, \"errors\": %u, \"ops_per_s\": %.1f",
+		op,
+		ops,
+		errors,
+		ops / elapsed
+	);
+	bench_output_latency(stdout, "rtt_us", rtt);
+	bench_output_record_end(stdout);
+}
+
+static bool bench_control_ws(bench_ws_t *ws, const bench_control_op_t *op, uint32_t ops) {
+	bench_samples_t rtt = {0};
+	uint32_t errors		= 0;
+	uint64_t start		= bench_time_us();
+	for (uint32_t i = 0; i < ops; i++) {
+		uint64_t sent_at = bench_time_us();
+		if (!bench_ws_send(ws, op->opcode, op->data, op->len, NULL) || !bench_ws_wait(ws, 0)) {
+			bench_samples_free(&rtt);
+			return false;
+		}
+		bench_samples_add(&rtt, bench_time_us() - sent_at);
+		if (ws->last_opcode != WSM_OK)
+			errors++;
+	}
+	bench_control_output(op->name, ops, errors, (bench_time_us() - start) / 1e6, &rtt);
+	bench_samples_free(&rtt);
+	return true;
+}
+
+static bool bench_control_stdmsg(bench_host_t *host, const char *action, const char *extra, uint32_t ops) {
+	bench_samples_t rtt = {0};
+	uint32_t errors		= 0;
+	uint64_t start		= bench_time_us();
+	char data[64];
+	for (uint32_t i = 0; i < ops; i++) {
+		uint64_t sent_at = bench_time_us();
+		// the port list is long - don't copy it
+		if (!bench_host_request(host, action, extra, extra != NULL ? data : NULL, sizeof(data)))
+			errors++;
+		bench_samples_add(&rtt, bench_time_us() - sent_at);
+	}
+	bench_control_output(action, ops, errors, (bench_time_us() - start) / 1e6, &rtt);
+	bench_samples_free(&rtt);
+	// a broken pipe fails every request
+	return errors != ops;
+}
+
+int bench_control(const bench_options_t *options) {
+	bench_host_t host;
+	if (!bench_host_start(&host, options->host_path)) {
+		fprintf(stderr, "Couldn't start the host: %s\n", options->host_path);
+		return 1;
+	}
+
+	bench_ws_t ws = {0};
+	bench_pty_t pty;
+	if (!bench_port_open(&host, &ws, &pty, options)) {
+		fprintf(stderr, "Couldn't open the port\n");
+		bench_host_stop(&host);
+		return 1;
+	}
+
+	int ret = 0;
+	bench_output_begin(stdout);
+	for (uint32_t i = 0; i < sizeof(bench_control_ops) / sizeof(*bench_control_ops); i++) {
+		fprintf(stderr, "%s: %u ops\n", bench_control_ops[i].name, options->ops);
+		if (!bench_control_ws(&ws, &bench_control_ops[i], options->ops))
+			ret = 1;
+	}
+
+	char extra[128];
+	snprintf(extra, sizeof(extra), "\"port\":\"%s\"", pty.name);
+	fprintf(stderr, "authGrant: %u ops\n", options->ops);
+	if (!bench_control_stdmsg(&host, "authGrant", extra, options->ops))
+		ret = 1;
+	fprintf(stderr, "listPorts: %u ops\n", options->ops);
+	if (!bench_control_stdmsg(&host, "listPorts", NULL, options->ops))
+		ret = 1;
+	bench_output_end(stdout);
+
+	bench_port_close(&ws, &pty);
+	bench_host_stop(&host);
+	return ret;
+}
@@ -0,0 +1,270 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "bench.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// WSM_DATA frames sent without waiting for their response
+#define BENCH_DATA_TX_WINDOW 4
+// how long to wait for in-flight data after the senders stop
+#define BENCH_DATA_DRAIN_MS	 2000
+
+typedef struct {
+	bench_ws_t ws;
+	bench_pty_t pty;
+	bool tx;			  // page -> device, otherwise device -> page
+	bool rx_flow;		  // return RX credits for the received data
+	uint32_t chunk;		  // bytes written at once
+	uint32_t interval_us; // pacing of the writes, 0 to write as fast as possible
+	pthread_t sender;
+	pthread_t receiver;
+	atomic_bool stop;
+	atomic_uint_fast64_t sent;
+	atomic_uint_fast64_t received;
+	atomic_uint_fast64_t frames; // WebSocket frames, sent or received
+	// per-chunk write timestamps, only when measuring latency
+	_Atomic uint64_t *sent_at;
+	uint32_t sent_at_len;
+	uint32_t next_chunk; // first chunk that didn't fully arrive yet
+	bench_samples_t latency;
+} bench_data_port_t;
+
+static bool bench_data_write(int fd, const uint8_t *data, uint32_t len) {
+	while (len != 0) {
+		ssize_t count = write(fd, data, len);
+		if (count <= 0) {
+			if (count < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		data += count;
+		len -= count;
+	}
+	return true;
+}
+
+static void bench_data_received(bench_data_port_t *port, uint32_t len) {
+	uint64_t received = atomic_fetch_add(&port->received, len) + len;
+	if (port->sent_at == NULL)
+		return;
+	// a chunk arrived once all of its bytes did
+	uint64_t now = bench_time_us();
+	while (port->next_chunk < port->sent_at_len && received >= (uint64_t)(port->next_chunk + 1) * port->chunk) {
+		uint64_t sent_at = atomic_load(&port->sent_at[port->next_chunk]);
+		if (sent_at == 0)
+			break;
+		bench_samples_add(&port->latency, now - sent_at);
+		port->next_chunk++;
+	}
+}
+
+static void bench_data_on_data(bench_ws_t *ws, const uint8_t *data, uint32_t len) {
+	bench_data_port_t *port = ws->arg;
+	atomic_fetch_add(&port->frames, 1);
+	bench_data_received(port, len);
+	if (port->rx_flow) {
+		// give the credits back right away, like a page reading as fast as it can
+		uint32_t credits = len;
+		bench_ws_send(ws, WSM_RX_CREDIT, &credits, sizeof(credits), NULL);
+	}
+}
+
+static void *bench_data_sender(void *arg) {
+	bench_data_port_t *port = arg;
+	// WSM_DATA starts with the 'drain' flag
+	uint8_t *buf = calloc(1, 1 + port->chunk);
+	if (buf == NULL)
+		return NULL;
+	uint8_t *data = buf + 1;
+	for (uint32_t i = 0; i < port->chunk; i++) {
+		data[i] = i;
+	}
+
+	uint64_t next = bench_time_us();
+	for (uint32_t index = 0; !atomic_load(&port->stop); index++) {
+		if (port->interval_us != 0) {
+			if (index >= port->sent_at_len)
+				break;
+			uint64_t now = bench_time_us();
+			if (next > now)
+				bench_sleep_us(next - now);
+			next += port->interval_us;
+		}
+		if (port->sent_at != NULL)
+			atomic_store(&port->sent_at[index], bench_time_us());
+		if (port->tx) {
+			if (!bench_ws_wait(&port->ws, BENCH_DATA_TX_WINDOW - 1))
+				break;
+			if (!bench_ws_send(&port->ws, WSM_DATA, buf, 1 + port->chunk, NULL))
+				break;
+			atomic_fetch_add(&port->frames, 1);
+		} else if (!bench_data_write(port->pty.master_fd, data, port->chunk)) {
+			break;
+		}
+		atomic_fetch_add(&port->sent, port->chunk);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static void *bench_data_receiver(void *arg) {
+	bench_data_port_t *port = arg;
+	uint8_t buf[65536];
+	while (!atomic_load(&port->stop) || atomic_load(&port->received) < atomic_load(&port->sent)) {
+		struct pollfd pfd = {
+			.fd		= port->pty.master_fd,
+			.events = POLLIN,
+		};
+		int count = poll(&pfd, 1, 100);
+		if (count < 0 && errno != EINTR)
+			break;
+		if (count <= 0)
+			continue;
+		ssize_t len = read(port->pty.master_fd, buf, sizeof(buf));
+		if (len <= 0)
+			break;
+		bench_data_received(port, len);
+	}
+	return NULL;
+}
+
+static bool bench_data_run(
+	bench_host_t *host,
+	const bench_options_t *options,
+	bool tx,
+	uint32_t chunk,
+	uint32_t ports_len,
+	bool paced
+) {
+	bench_data_port_t *ports = calloc(ports_len, sizeof(*ports));
+	if (ports == NULL)
+		return false;
+
+	bool ret			 = false;
+	uint32_t opened		 = 0;
+	uint32_t sent_at_len = paced ? (uint64_t)options->duration_ms * 1000 / options->interval_us : 0;
+	for (; opened < ports_len; opened++) {
+		bench_data_port_t *port = &ports[opened];
+		port->tx				= tx;
+		port->rx_flow			= options->rx_window != 0;
+		port->chunk				= chunk;
+		port->interval_us		= paced ? options->interval_us : 0;
+		port->ws.on_data		= tx ? NULL : bench_data_on_data;
+		port->ws.arg			= port;
+		if (paced) {
+			port->sent_at	  = calloc(sent_at_len, sizeof(*port->sent_at));
+			port->sent_at_len = sent_at_len;
+			if (port->sent_at == NULL)
+				goto end;
+		}
+		if (!bench_port_open(host, &port->ws, &port->pty, options)) {
+			fprintf(stderr, "Couldn't open port #%u\n", opened);
+			goto end;
+		}
+	}
+
+	uint64_t start = bench_time_us();
+	for (uint32_t i = 0; i < ports_len; i++) {
+		pthread_create(&ports[i].sender, NULL, bench_data_sender, &ports[i]);
+		if (tx)
+			pthread_create(&ports[i].receiver, NULL, bench_data_receiver, &ports[i]);
+	}
+	bench_sleep_us((uint64_t)options->duration_ms * 1000);
+
+	uint64_t bytes	= 0;
+	uint64_t frames = 0;
+	for (uint32_t i = 0; i < ports_len; i++) {
+		atomic_store(&ports[i].stop, true);
+		bytes += atomic_load(&ports[i].received);
+		frames += atomic_load(&ports[i].frames);
+	}
+	double elapsed = (bench_time_us() - start) / 1e6;
+	for (uint32_t i = 0; i < ports_len; i++) {
+		pthread_join(ports[i].sender, NULL);
+	}
+
+	// let the data in flight arrive before closing the ports
+	uint64_t deadline = bench_time_us() + BENCH_DATA_DRAIN_MS * 1000;
+	for (uint32_t i = 0; i < ports_len; i++) {
+		bench_data_port_t *port = &ports[i];
+		while (atomic_load(&port->received) < atomic_load(&port->sent) && bench_time_us() < deadline) {
+			bench_sleep_us(1000);
+		}
+		if (tx)
+			pthread_join(port->receiver, NULL);
+	}
+
+	bench_samples_t latency = {0};
+	for (uint32_t i = 0; i < ports_len; i++) {
+		for (uint32_t j = 0; j < ports[i].latency.len; j++) {
+			bench_samples_add(&latency, ports[i].latency.values[j]);
+		}
+	}
+
+	bench_output_record_begin(
+		stdout,
+		"\"scenario\": \"%s\", \"mode\": \"%s\", \"chunk\": %u, \"ports\": %u, "
+		"\"mb_per_s\": %.3f, \"frames_per_s\": %.1f",
+		tx ? "tx" : "rx",
+		paced ? "latency" : "throughput",
+		chunk,
+		ports_len,
+		bytes / elapsed / 1e6,
+		frames / elapsed
+	);
+	if (paced)
+		bench_output_latency(stdout, "latency_us", &latency);
+	bench_output_record_end(stdout);
+	bench_samples_free(&latency);
+	ret = true;
+
+end:
+	for (uint32_t i = 0; i < opened; i++) {
+		bench_port_close(&ports[i].ws, &ports[i].pty);
+	}
+	for (uint32_t i = 0; i < ports_len; i++) {
+		free(ports[i].sent_at);
+		bench_samples_free(&ports[i].latency);
+	}
+	free(ports);
+	return ret;
+}
+
+int bench_data(const bench_options_t *options) {
+	bench_host_t host;
+	if (!bench_host_start(&host, options->host_path)) {
+		fprintf(stderr, "Couldn't start the host: %s\n", options->host_path);
+		return 1;
+	}
+
+	int ret = 0;
+	bench_output_begin(stdout);
+	for (int tx = 0; tx <= 1; tx++) {
+		for (int i = 0; i < options->chunks_len; i++) {
+			for (int j = 0; j < options->ports_len; j++) {
+				for (int paced = 0; paced <= 1; paced++) {
+					fprintf(
+						stderr,
+						"%s: chunk %u, %u port(s), %s\n",
+						tx ? "TX" : "RX",
+						options->chunks[i],
+						options->ports[j],
+						paced ? "latency" : "throughput"
+					);
+					if (!bench_data_run(&host, options, tx, options->chunks[i], options->ports[j], paced))
+						ret = 1;
+				}
+			}
+		}
+	}
+	bench_output_end(stdout);
+
+	bench_host_stop(&host);
+	return ret;
+}
@@ -0,0 +1,169 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "bench.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static bool bench_host_read(bench_host_t *host, void *buf, uint32_t len) {
+	uint8_t *data = buf;
+	while (len != 0) {
+		struct pollfd pfd = {
+			.fd		= host->out_fd,
+			.events = POLLIN,
+		};
+		if (poll(&pfd, 1, BENCH_TIMEOUT_MS) <= 0)
+			return false;
+		ssize_t count = read(host->out_fd, data, len);
+		if (count <= 0) {
+			if (count < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		data += count;
+		len -= count;
+	}
+	return true;
+}
+
+static bool bench_host_write(bench_host_t *host, const void *buf, uint32_t len) {
+	const uint8_t *data = buf;
+	while (len != 0) {
+		ssize_t count = write(host->in_fd, data, len);
+		if (count <= 0) {
+			if (count < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		data += count;
+		len -= count;
+	}
+	return true;
+}
+
+bool bench_host_start(bench_host_t *host, const char *path) {
+	int in_pipe[2];
+	int out_pipe[2];
+	if (pipe(in_pipe) != 0)
+		return false;
+	if (pipe(out_pipe) != 0) {
+		close(in_pipe[0]);
+		close(in_pipe[1]);
+		return false;
+	}
+
+	host->pid = fork();
+	if (host->pid == 0) {
+		dup2(in_pipe[0], STDIN_FILENO);
+		dup2(out_pipe[1], STDOUT_FILENO);
+		close(in_pipe[0]);
+		close(in_pipe[1]);
+		close(out_pipe[0]);
+		close(out_pipe[1]);
+		execl(path, path, NULL);
+		_exit(127);
+	}
+	close(in_pipe[0]);
+	close(out_pipe[1]);
+	host->in_fd	   = in_pipe[1];
+	host->out_fd   = out_pipe[0];
+	host->next_id  = 1;
+	host->buf	   = NULL;
+	host->buf_size = 0;
+	if (host->pid < 0) {
+		bench_host_stop(host);
+		return false;
+	}
+	// broken pipes are reported by write()
+	signal(SIGPIPE, SIG_IGN);
+
+	// make sure the host is up and talks the same protocol
+	return bench_host_request(host, "ping", NULL, NULL, 0);
+}
+
+void bench_host_stop(bench_host_t *host) {
+	// closing stdin makes the host exit
+	if (host->in_fd != -1)
+		close(host->in_fd);
+	if (host->pid > 0)
+		waitpid(host->pid, NULL, 0);
+	if (host->out_fd != -1)
+		close(host->out_fd);
+	free(host->buf);
+	host->in_fd	 = -1;
+	host->out_fd = -1;
+	host->pid	 = 0;
+	host->buf	 = NULL;
+}
+
+static bool bench_host_copy_data(const char *json, char *data, uint32_t data_size) {
+	const char *value = strstr(json, "\"data\":");
+	if (value == NULL)
+		return false;
+	value += sizeof("\"data\":") - 1;
+	// strings are copied without the quotes, anything else as raw JSON up to the end of the message
+	uint32_t len;
+	if (*value == '"') {
+		value++;
+		const char *end = strchr(value, '"');
+		if (end == NULL)
+			return false;
+		len = end - value;
+	} else {
+		len = strlen(value) - 1;
+	}
+	if (len >= data_size)
+		len = data_size - 1;
+	memcpy(data, value, len);
+	data[len] = '\0';
+	return true;
+}
+
+bool bench_host_request(bench_host_t *host, const char *action, const char *extra, char *data, uint32_t data_size) {
+	char id[16];
+	snprintf(id, sizeof(id), "%u", host->next_id++);
+
+	char request[1024];
+	uint32_t len = snprintf(
+		request + sizeof(uint32_t),
+		sizeof(request) - sizeof(uint32_t),
+		"{\"action\":\"%s\",\"id\":\"%s\"%s%s}",
+		action,
+		id,
+		extra != NULL ? "," : "",
+		extra != NULL ? extra : ""
+	);
+	memcpy(request, &len, sizeof(uint32_t));
+	if (!bench_host_write(host, request, sizeof(uint32_t) + len))
+		return false;
+
+	char id_field[32];
+	snprintf(id_field, sizeof(id_field), "\"id\":\"%s\"", id);
+	while (1) {
+		// skip logs and events until the response comes
+		if (!bench_host_read(host, &len, sizeof(uint32_t)))
+			return false;
+		if (len + 1 > host->buf_size) {
+			char *buf = realloc(host->buf, len + 1);
+			if (buf == NULL)
+				return false;
+			host->buf	   = buf;
+			host->buf_size = len + 1;
+		}
+		if (!bench_host_read(host, host->buf, len))
+			return false;
+		host->buf[len] = '\0';
+		if (strstr(host->buf, id_field) == NULL)
+			continue;
+		if (strstr(host->buf, "\"error\":") != NULL)
+			return false;
+		if (data != NULL)
+			return bench_host_copy_data(host->buf, data, data_size);
+		return true;
+	}
+}
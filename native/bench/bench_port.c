@@ -0,0 +1,44 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "bench.h"
+
+#include <string.h>
+
+bool bench_port_open(bench_host_t *host, bench_ws_t *ws, bench_pty_t *pty, const bench_options_t *options) {
+	if (!bench_pty_open(pty))
+		return false;
+
+	char extra[128];
+	snprintf(extra, sizeof(extra), "\"port\":\"%s\"", pty->name);
+	char auth_key[64];
+	if (!bench_host_request(host, "authGrant", extra, auth_key, sizeof(auth_key)))
+		goto error;
+
+	if (!bench_ws_connect(ws, options->ws_port, ws->on_data, ws->arg))
+		goto error;
+	if (!bench_ws_request(ws, WSM_PORT_OPEN, auth_key, strlen(auth_key) + 1))
+		goto error_ws;
+
+	// the baudrate doesn't limit a PTY, but the host sizes its TX queue after it
+	uint8_t config[] = {0x00, 0x10, 0x0E, 0x00, 8, 0, 1}; // 921600 8N1
+	if (!bench_ws_request(ws, WSM_SET_CONFIG, config, sizeof(config)))
+		goto error_ws;
+	if (options->rx_window != 0) {
+		uint32_t credits = options->rx_window;
+		if (!bench_ws_request(ws, WSM_SET_RX_FLOW, &credits, sizeof(credits)))
+			goto error_ws;
+	}
+	return true;
+
+error_ws:
+	bench_ws_close(ws);
+error:
+	bench_pty_close(pty);
+	return false;
+}
+
+void bench_port_close(bench_ws_t *ws, bench_pty_t *pty) {
+	bench_ws_request(ws, WSM_PORT_CLOSE, NULL, 0);
+	bench_ws_close(ws);
+	bench_pty_close(pty);
+}
@@ -0,0 +1,43 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#define _GNU_SOURCE // posix_openpt()
+
+#include "bench.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+bool bench_pty_open(bench_pty_t *pty) {
+	if ((pty->master_fd = posix_openpt(O_RDWR | O_NOCTTY)) == -1)
+		return false;
+	if (grantpt(pty->master_fd) != 0 || unlockpt(pty->master_fd) != 0)
+		goto error;
+	const char *name = ptsname(pty->master_fd);
+	if (name == NULL || strlen(name) >= sizeof(pty->name))
+		goto error;
+	strcpy(pty->name, name);
+
+	// no line discipline on either side, so that data passes through unchanged
+	struct termios tio;
+	if (tcgetattr(pty->master_fd, &tio) != 0)
+		goto error;
+	cfmakeraw(&tio);
+	if (tcsetattr(pty->master_fd, TCSANOW, &tio) != 0)
+		goto error;
+	return true;
+
+error:
+	close(pty->master_fd);
+	pty->master_fd = -1;
+	return false;
+}
+
+void bench_pty_close(bench_pty_t *pty) {
+	if (pty->master_fd == -1)
+		return;
+	close(pty->master_fd);
+	pty->master_fd = -1;
+}
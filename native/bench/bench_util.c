@@ -0,0 +1,95 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "bench.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+
+// records are separated by commas
+static bool output_first = true;
+
+uint64_t bench_time_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void bench_sleep_us(uint64_t us) {
+	struct timespec ts = {
+		.tv_sec	 = us / 1000000,
+		.tv_nsec = (us % 1000000) * 1000,
+	};
+	nanosleep(&ts, NULL);
+}
+
+void bench_samples_add(bench_samples_t *samples, double value) {
+	if (samples->len == samples->size) {
+		uint32_t size  = samples->size ? samples->size * 2 : 1024;
+		double *values = realloc(samples->values, size * sizeof(*values));
+		if (values == NULL)
+			return;
+		samples->values = values;
+		samples->size	= size;
+	}
+	samples->values[samples->len++] = value;
+}
+
+static int bench_samples_compare(const void *a, const void *b) {
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+double bench_samples_percentile(bench_samples_t *samples, double percentile) {
+	if (samples->len == 0)
+		return 0;
+	qsort(samples->values, samples->len, sizeof(*samples->values), bench_samples_compare);
+	uint32_t index = (uint32_t)(percentile / 100.0 * (samples->len - 1) + 0.5);
+	return samples->values[index];
+}
+
+void bench_samples_free(bench_samples_t *samples) {
+	free(samples->values);
+	samples->values = NULL;
+	samples->len	= 0;
+	samples->size	= 0;
+}
+
+void bench_output_begin(FILE *out) {
+	fprintf(out, "[\n");
+	output_first = true;
+}
+
+void bench_output_record_begin(FILE *out, const char *fmt, ...) {
+	// more fields can be added before bench_output_record_end()
+	fprintf(out, output_first ? "\t{" : ",\n\t{");
+	output_first = false;
+	va_list argv;
+	va_start(argv, fmt);
+	vfprintf(out, fmt, argv);
+	va_end(argv);
+}
+
+void bench_output_latency(FILE *out, const char *key, bench_samples_t *samples) {
+	fprintf(
+		out,
+		", \"%s\": {\"samples\": %u, \"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}",
+		key,
+		samples->len,
+		bench_samples_percentile(samples, 50),
+		bench_samples_percentile(samples, 99),
+		bench_samples_percentile(samples, 99.9),
+		bench_samples_percentile(samples, 100)
+	);
+}
+
+void bench_output_record_end(FILE *out) {
+	fprintf(out, "}");
+	fflush(out);
+}
+
+void bench_output_end(FILE *out) {
+	fprintf(out, "\n]\n");
+	fflush(out);
+}
@@ -0,0 +1,255 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static bool bench_ws_read(int fd, void *buf, uint32_t len) {
+	uint8_t *data = buf;
+	while (len != 0) {
+		ssize_t count = recv(fd, data, len, 0);
+		if (count <= 0) {
+			if (count < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		data += count;
+		len -= count;
+	}
+	return true;
+}
+
+static bool bench_ws_write(int fd, const void *buf, uint32_t len) {
+	const uint8_t *data = buf;
+	while (len != 0) {
+		ssize_t count = send(fd, data, len, MSG_NOSIGNAL);
+		if (count <= 0) {
+			if (count < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		data += count;
+		len -= count;
+	}
+	return true;
+}
+
+static void bench_ws_on_frame(bench_ws_t *ws, const uint8_t *data, uint32_t len) {
+	if (len == 0)
+		return;
+	if (data[0] == WSM_DATA) {
+		// RX data is the only message without a sequence number
+		if (ws->on_data != NULL)
+			ws->on_data(ws, data + 1, len - 1);
+		return;
+	}
+	if (len < BENCH_WS_HEADER)
+		return;
+	uint16_t seq = data[1] | (data[2] << 8);
+	pthread_mutex_lock(&ws->mutex);
+	if (seq == 0) {
+		// reader error, not a response to anything
+		ws->closed = true;
+	} else {
+		ws->in_flight--;
+		ws->last_opcode = data[0];
+		ws->last_seq	= seq;
+		if (len >= BENCH_WS_HEADER + sizeof(uint32_t))
+			memcpy(&ws->last_credits, data + BENCH_WS_HEADER, sizeof(uint32_t));
+	}
+	pthread_cond_broadcast(&ws->cond);
+	pthread_mutex_unlock(&ws->mutex);
+}
+
+static void *bench_ws_reader(void *arg) {
+	bench_ws_t *ws = arg;
+	uint8_t *buf   = malloc(BENCH_WS_MAX);
+	if (buf == NULL)
+		goto end;
+
+	while (1) {
+		uint8_t header[2];
+		if (!bench_ws_read(ws->fd, header, sizeof(header)))
+			break;
+		uint64_t len = header[1] & 0x7F;
+		if (len == 126) {
+			uint8_t ext[2];
+			if (!bench_ws_read(ws->fd, ext, sizeof(ext)))
+				break;
+			len = (ext[0] << 8) | ext[1];
+		} else if (len == 127) {
+			uint8_t ext[8];
+			if (!bench_ws_read(ws->fd, ext, sizeof(ext)))
+				break;
+			len = 0;
+			for (int i = 0; i < 8; i++) {
+				len = (len << 8) | ext[i];
+			}
+		}
+		if (len > BENCH_WS_MAX || !bench_ws_read(ws->fd, buf, len))
+			break;
+		uint8_t opcode = header[0] & 0x0F;
+		if (opcode == 0x8)
+			break;
+		if (opcode == 0x2)
+			bench_ws_on_frame(ws, buf, len);
+	}
+
+end:
+	free(buf);
+	pthread_mutex_lock(&ws->mutex);
+	ws->closed = true;
+	pthread_cond_broadcast(&ws->cond);
+	pthread_mutex_unlock(&ws->mutex);
+	return NULL;
+}
+
+bool bench_ws_connect(bench_ws_t *ws, int port, bench_ws_data_cb_t on_data, void *arg) {
+	memset(ws, 0, sizeof(*ws));
+	ws->next_seq = 1;
+	ws->on_data	 = on_data;
+	ws->arg		 = arg;
+
+	if ((ws->fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		return false;
+	int one = 1;
+	setsockopt(ws->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	struct sockaddr_in addr = {
+		.sin_family		 = AF_INET,
+		.sin_port		 = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	// the host might still be starting its server
+	int retries = 50;
+	while (connect(ws->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		if (--retries == 0)
+			goto error;
+		bench_sleep_us(100000);
+	}
+
+	char request[256];
+	int len = snprintf(
+		request,
+		sizeof(request),
+		"GET / HTTP/1.1\r\n"
+		"Host: 127.0.0.1:%d\r\n"
+		"Upgrade: websocket\r\n"
+		"Connection: Upgrade\r\n"
+		"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+		"Sec-WebSocket-Version: 13\r\n"
+		"\r\n",
+		port
+	);
+	if (!bench_ws_write(ws->fd, request, len))
+		goto error;
+
+	// read the response headers byte by byte, so that no frame data is consumed
+	char response[1024];
+	uint32_t pos = 0;
+	while (pos < sizeof(response) - 1) {
+		if (!bench_ws_read(ws->fd, response + pos, 1))
+			goto error;
+		pos++;
+		if (pos >= 4 && memcmp(response + pos - 4, "\r\n\r\n", 4) == 0)
+			break;
+	}
+	response[pos] = '\0';
+	if (strstr(response, " 101 ") == NULL)
+		goto error;
+
+	pthread_mutex_init(&ws->send_mutex, NULL);
+	pthread_mutex_init(&ws->mutex, NULL);
+	pthread_cond_init(&ws->cond, NULL);
+	if (pthread_create(&ws->thread, NULL, bench_ws_reader, ws) != 0)
+		goto error;
+	return true;
+
+error:
+	close(ws->fd);
+	ws->fd = -1;
+	return false;
+}
+
+void bench_ws_close(bench_ws_t *ws) {
+	if (ws->fd == -1)
+		return;
+	shutdown(ws->fd, SHUT_RDWR);
+	pthread_join(ws->thread, NULL);
+	close(ws->fd);
+	ws->fd = -1;
+	pthread_cond_destroy(&ws->cond);
+	pthread_mutex_destroy(&ws->mutex);
+	pthread_mutex_destroy(&ws->send_mutex);
+}
+
+bool bench_ws_send(bench_ws_t *ws, uint8_t opcode, const void *data, uint32_t len, uint16_t *seq) {
+	uint8_t header[14 + BENCH_WS_HEADER];
+	uint32_t payload_len = BENCH_WS_HEADER + len;
+	uint32_t header_len	 = 2;
+	header[0]			 = 0x80 | 0x2;
+	if (payload_len < 126) {
+		header[1] = 0x80 | payload_len;
+	} else if (payload_len <= 0xFFFF) {
+		header[1]			 = 0x80 | 126;
+		header[header_len++] = payload_len >> 8;
+		header[header_len++] = payload_len;
+	} else {
+		header[1] = 0x80 | 127;
+		for (int i = 7; i >= 0; i--) {
+			header[header_len++] = i < 4 ? payload_len >> (i * 8) : 0;
+		}
+	}
+	// a zero masking key leaves the payload as-is
+	memset(header + header_len, 0, 4);
+	header_len += 4;
+
+	pthread_mutex_lock(&ws->send_mutex);
+	pthread_mutex_lock(&ws->mutex);
+	uint16_t frame_seq = ws->next_seq++;
+	if (ws->next_seq == 0)
+		ws->next_seq = 1;
+	ws->in_flight++;
+	pthread_mutex_unlock(&ws->mutex);
+
+	header[header_len++] = opcode;
+	header[header_len++] = frame_seq;
+	header[header_len++] = frame_seq >> 8;
+	bool ret			 = bench_ws_write(ws->fd, header, header_len) && bench_ws_write(ws->fd, data, len);
+	pthread_mutex_unlock(&ws->send_mutex);
+	if (seq != NULL)
+		*seq = frame_seq;
+	return ret;
+}
+
+bool bench_ws_wait(bench_ws_t *ws, uint32_t max_in_flight) {
+	uint64_t deadline = bench_time_us() + BENCH_TIMEOUT_MS * 1000;
+	pthread_mutex_lock(&ws->mutex);
+	while (ws->in_flight > max_in_flight && !ws->closed && bench_time_us() < deadline) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += 10000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&ws->cond, &ws->mutex, &ts);
+	}
+	bool ret = ws->in_flight <= max_in_flight;
+	pthread_mutex_unlock(&ws->mutex);
+	return ret;
+}
+
+bool bench_ws_request(bench_ws_t *ws, uint8_t opcode, const void *data, uint32_t len) {
+	if (!bench_ws_send(ws, opcode, data, len, NULL))
+		return false;
+	if (!bench_ws_wait(ws, 0))
+		return false;
+	return ws->last_opcode == WSM_OK;
+}
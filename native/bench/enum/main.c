@@ -0,0 +1,339 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#define LIBSERIALPORT_ATBUILD
+#include "libserialport_internal.h"
+#undef DEBUG
+
+#include "serial.h"
+
+#include "../bench.h"
+
+#include <getopt.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+typedef struct {
+	const char *root;
+	char path[PATH_MAX];
+} bench_tree_t;
+
+// false if it doesn't fit, instead of a truncated path somewhere else in the tree
+__attribute__((format(printf, 3, 4))) static bool bench_path(char *path, size_t size, const char *fmt, ...) {
+	va_list argv;
+	va_start(argv, fmt);
+	int len = vsnprintf(path, size, fmt, argv);
+	va_end(argv);
+	return len >= 0 && (size_t)len < size;
+}
+
+static bool bench_tree_mkdir(const char *path) {
+	char buf[PATH_MAX];
+	snprintf(buf, sizeof(buf), "%s", path);
+	for (char *slash = strchr(buf + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		if (mkdir(buf, 0755) != 0 && errno != EEXIST)
+			return false;
+		*slash = '/';
+	}
+	return mkdir(buf, 0755) == 0 || errno == EEXIST;
+}
+
+static const char *bench_tree_path(bench_tree_t *tree, const char *fmt, ...) {
+	int len = snprintf(tree->path, sizeof(tree->path), "%s/", tree->root);
+	va_list argv;
+	va_start(argv, fmt);
+	vsnprintf(tree->path + len, sizeof(tree->path) - len, fmt, argv);
+	va_end(argv);
+	return tree->path;
+}
+
+static bool bench_tree_file(const char *dir, const char *name, const char *value) {
+	char path[PATH_MAX];
+	if (!bench_path(path, sizeof(path), "%s/%s", dir, name))
+		return false;
+	FILE *file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+	fprintf(file, "%s\n", value);
+	return fclose(file) == 0;
+}
+
+static bool bench_tree_link(const char *dir, const char *name, const char *target) {
+	char path[PATH_MAX];
+	if (!bench_path(path, sizeof(path), "%s/%s", dir, name))
+		return false;
+	return symlink(target, path) == 0 || errno == EEXIST;
+}
+
+static bool bench_tree_tty(bench_tree_t *tree, const char *tty, const char *tty_dir, const char *device) {
+	// the class entry links to the tty in its device hierarchy, like in /sys
+	char dir[PATH_MAX];
+	snprintf(dir, sizeof(dir), "%s", tty_dir);
+	if (!bench_tree_mkdir(dir))
+		return false;
+	if (device != NULL && !bench_tree_link(dir, "device", device))
+		return false;
+	return bench_tree_link(bench_tree_path(tree, "class/tty"), tty, dir);
+}
+
+static bool bench_tree_usb(bench_tree_t *tree, uint32_t index, char *device, uint32_t device_size) {
+	if (!bench_path(device, device_size, "%s/devices/usb1/1-%u", tree->root, index))
+		return false;
+	char value[32];
+	bool ret = bench_tree_mkdir(device);
+	ret		 = ret && bench_tree_file(device, "idVendor", "0403");
+	snprintf(value, sizeof(value), "%04x", 0x6000 + index % 16);
+	ret = ret && bench_tree_file(device, "idProduct", value);
+	ret = ret && bench_tree_file(device, "manufacturer", "FTDI");
+	ret = ret && bench_tree_file(device, "product", "FT232R USB UART");
+	snprintf(value, sizeof(value), "A%07u", index);
+	ret = ret && bench_tree_file(device, "serial", value);
+	ret = ret && bench_tree_file(device, "busnum", "1");
+	snprintf(value, sizeof(value), "%u", index % 127 + 1);
+	ret = ret && bench_tree_file(device, "devnum", value);
+	return ret;
+}
+
+static bool bench_tree_create(bench_tree_t *tree, uint32_t devices) {
+	const char *dirs[] = {"class/tty", "bus/usb", "bus/usb-serial", "bus/platform/drivers/serial8250"};
+	for (uint32_t i = 0; i < sizeof(dirs) / sizeof(*dirs); i++) {
+		if (!bench_tree_mkdir(bench_tree_path(tree, "%s", dirs[i])))
+			return false;
+	}
+	char platform[PATH_MAX];
+	if (!bench_path(platform, sizeof(platform), "%s/devices/platform/serial8250", tree->root) ||
+		!bench_tree_mkdir(platform) || !bench_tree_link(platform, "subsystem", bench_tree_path(tree, "bus/platform")) ||
+		!bench_tree_link(platform, "driver", bench_tree_path(tree, "bus/platform/drivers/serial8250")))
+		return false;
+
+	// an even mix of USB serial converters, CDC-ACM devices, 8250 ports (half of them without a UART) and consoles
+	for (uint32_t i = 0; i < devices; i++) {
+		char tty[32];
+		char tty_dir[PATH_MAX];
+		char device[PATH_MAX];
+		char port[PATH_MAX];
+		switch (i % 4) {
+			case 0:
+				snprintf(tty, sizeof(tty), "ttyUSB%u", i / 4);
+				if (!bench_tree_usb(tree, i, device, sizeof(device)))
+					return false;
+				if (!bench_path(port, sizeof(port), "%s/1-%u:1.0/%s", device, i, tty) || !bench_tree_mkdir(port) ||
+					!bench_tree_link(port, "subsystem", bench_tree_path(tree, "bus/usb-serial")))
+					return false;
+				if (!bench_path(tty_dir, sizeof(tty_dir), "%s/tty/%s", port, tty) ||
+					!bench_tree_tty(tree, tty, tty_dir, port))
+					return false;
+				break;
+
+			case 1:
+				snprintf(tty, sizeof(tty), "ttyACM%u", i / 4);
+				if (!bench_tree_usb(tree, i, device, sizeof(device)))
+					return false;
+				if (!bench_path(port, sizeof(port), "%s/1-%u:1.0", device, i) || !bench_tree_mkdir(port) ||
+					!bench_tree_link(port, "subsystem", bench_tree_path(tree, "bus/usb")))
+					return false;
+				if (!bench_path(tty_dir, sizeof(tty_dir), "%s/tty/%s", port, tty) ||
+					!bench_tree_tty(tree, tty, tty_dir, port))
+					return false;
+				break;
+
+			case 2:
+				snprintf(tty, sizeof(tty), "ttyS%u", i / 4);
+				if (!bench_path(tty_dir, sizeof(tty_dir), "%s/tty/%s", platform, tty))
+					return false;
+				if (!bench_tree_tty(tree, tty, tty_dir, platform) || !bench_tree_file(tty_dir, "type", i % 8 == 2 ? "4" : "0"))
+					return false;
+				break;
+
+			case 3:
+				snprintf(tty, sizeof(tty), "tty%u", i / 4);
+				if (!bench_path(tty_dir, sizeof(tty_dir), "%s/devices/virtual/tty/%s", tree->root, tty) ||
+					!bench_tree_tty(tree, tty, tty_dir, NULL))
+					return false;
+				break;
+		}
+	}
+	return true;
+}
+
+static void bench_tree_remove(bench_tree_t *tree) {
+	char command[PATH_MAX + 16];
+	snprintf(command, sizeof(command), "rm -rf '%s'", tree->root);
+	if (system(command) != 0)
+		fprintf(stderr, "Couldn't remove %s\n", tree->root);
+}
+
+static struct sp_port **bench_ports_create(uint32_t devices) {
+	struct sp_port **ports = calloc(devices, sizeof(*ports));
+	if (ports == NULL)
+		return NULL;
+	for (uint32_t i = 0; i < devices; i++) {
+		struct sp_port *port = calloc(1, sizeof(*port));
+		if (port == NULL)
+			return ports;
+		char buf[32];
+		snprintf(buf, sizeof(buf), i % 2 ? "/dev/ttyS%u" : "/dev/ttyUSB%u", i);
+		port->name		= strdup(buf);
+		port->transport = i % 2 ? SP_TRANSPORT_NATIVE : SP_TRANSPORT_USB;
+		port->usb_vid	= i % 2 ? -1 : 0x0403;
+		port->usb_pid	= i % 2 ? -1 : 0x6001;
+		snprintf(buf, sizeof(buf), "A%07u", i);
+		port->usb_serial = i % 2 ? NULL : strdup(buf);
+		port->fd		 = -1;
+		ports[i]		 = port;
+	}
+	return ports;
+}
+
+static void bench_ports_free(struct sp_port **ports, uint32_t devices) {
+	for (uint32_t i = 0; i < devices; i++) {
+		if (ports[i] != NULL)
+			sp_free_port(ports[i]);
+	}
+	free(ports);
+}
+
+static void bench_enum_output(const char *op, uint32_t devices, uint32_t ports, uint32_t ops, bench_samples_t *samples) {
+	double total = 0;
+	for (uint32_t i = 0; i < samples->len; i++) {
+		total += samples->values[i];
+	}
+	bench_output_record_begin(
+		stdout,
+		"\"scenario\": \"enum\", \"op\": \"%s\", \"devices\": %u, \"ports\": %u, \"ops\": %u, \"ops_per_s\": %.1f",
+		op,
+		devices,
+		ports,
+		ops,
+		ops / (total / 1e6)
+	);
+	bench_output_latency(stdout, "time_us", samples);
+	bench_output_record_end(stdout);
+}
+
+static bool bench_enum_list(const char *op, uint32_t devices, const serial_filter_t *filters, int filters_len, uint32_t ops) {
+	bench_samples_t samples = {0};
+	int ports				= 0;
+	for (uint32_t i = 0; i < ops; i++) {
+		uint64_t start = bench_time_us();
+		cJSON *data	   = serial_list_ports_json(filters, filters_len);
+		bench_samples_add(&samples, bench_time_us() - start);
+		if (data == NULL) {
+			bench_samples_free(&samples);
+			return false;
+		}
+		ports = cJSON_GetArraySize(data);
+		cJSON_Delete(data);
+	}
+	bench_enum_output(op, devices, ports, ops, &samples);
+	bench_samples_free(&samples);
+	return true;
+}
+
+static bool bench_enum_get_id(uint32_t devices, uint32_t ops) {
+	struct sp_port **ports = bench_ports_create(devices);
+	if (ports == NULL)
+		return false;
+	bench_samples_t samples = {0};
+	bool ret				= true;
+	for (uint32_t i = 0; i < ops && ret; i++) {
+		// one sample is one pass over all the ports
+		uint64_t start = bench_time_us();
+		for (uint32_t j = 0; j < devices && ret; j++) {
+			char *id = ports[j] != NULL ? serial_port_get_id(ports[j]) : NULL;
+			ret		 = id != NULL;
+			free(id);
+		}
+		bench_samples_add(&samples, bench_time_us() - start);
+	}
+	if (ret)
+		bench_enum_output("serial_port_get_id", devices, devices, ops, &samples);
+	bench_samples_free(&samples);
+	bench_ports_free(ports, devices);
+	return ret;
+}
+
+static bool bench_enum(uint32_t devices, uint32_t ops) {
+	char root[] = "/tmp/webserial-sysfs-XXXXXX";
+	bench_tree_t tree;
+	if ((tree.root = mkdtemp(root)) == NULL)
+		return false;
+	bool ret = bench_tree_create(&tree, devices);
+	if (!ret) {
+		fprintf(stderr, "Couldn't create the sysfs tree in %s\n", tree.root);
+		goto end;
+	}
+	char sysfs_tty[PATH_MAX];
+	snprintf(sysfs_tty, sizeof(sysfs_tty), "%s/class/tty", tree.root);
+	serial_linux_sysfs_tty = sysfs_tty;
+
+	serial_filter_t filters[] = {
+		{.transport = -1, .vid = 0x0403, .pid = 0x6001, .serial = NULL, .name = NULL},
+		{.transport = -1, .vid = -1, .pid = -1, .serial = NULL, .name = "/dev/ttyS*"},
+	};
+	ret = ret && bench_enum_list("serial_list_ports_json", devices, NULL, 0, ops);
+	ret = ret && bench_enum_list("serial_list_ports_json/usb", devices, &filters[0], 1, ops);
+	ret = ret && bench_enum_list("serial_list_ports_json/name", devices, &filters[1], 1, ops);
+	ret = ret && bench_enum_get_id(devices, ops);
+
+end:
+	serial_linux_sysfs_tty = "/sys/class/tty";
+	bench_tree_remove(&tree);
+	return ret;
+}
+
+static const struct option bench_long_options[] = {
+	{"devices", required_argument, NULL, 'D'},
+	{"ops", required_argument, NULL, 'n'},
+	{"help", no_argument, NULL, 'h'},
+	{NULL, 0, NULL, 0},
+};
+
+int main(int argc, char *argv[]) {
+	uint32_t devices[16] = {100, 500};
+	int devices_len		 = 2;
+	uint32_t ops		 = 200;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "D:n:h", bench_long_options, NULL)) != -1) {
+		char *end = optarg;
+		switch (opt) {
+			case 'D':
+				for (devices_len = 0; devices_len < 16; end++) {
+					char *value			   = end;
+					devices[devices_len++] = strtoul(value, &end, 0);
+					if (end == value || *end != ',')
+						break;
+				}
+				if (devices[devices_len - 1] != 0 && *end == '\0')
+					continue;
+				break;
+			case 'n':
+				if ((ops = strtoul(optarg, NULL, 0)) != 0)
+					continue;
+				break;
+		}
+		fprintf(
+			stderr,
+			"Usage: %s [options]\n"
+			"\n"
+			"Times serial_list_ports_json() and serial_port_get_id() against a synthetic sysfs tree.\n"
+			"\n"
+			"Options:\n"
+			"  -D, --devices <list>  comma-separated tty counts (default: 100,500)\n"
+			"  -n, --ops <n>         calls per measurement (default: 200)\n",
+			argv[0]
+		);
+		return 2;
+	}
+
+	int ret = 0;
+	bench_output_begin(stdout);
+	for (int i = 0; i < devices_len; i++) {
+		fprintf(stderr, "%u devices, %u ops\n", devices[i], ops);
+		if (!bench_enum(devices[i], ops))
+			ret = 1;
+	}
+	bench_output_end(stdout);
+	return ret;
+}
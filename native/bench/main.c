@@ -0,0 +1,130 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "bench.h"
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct option bench_long_options[] = {
+	{"duration", required_argument, NULL, 'd'},
+	{"chunks", required_argument, NULL, 'c'},
+	{"ports", required_argument, NULL, 'p'},
+	{"rx-window", required_argument, NULL, 'w'},
+	{"interval-us", required_argument, NULL, 'i'},
+	{"ws-port", required_argument, NULL, 'P'},
+	{"ops", required_argument, NULL, 'n'},
+	{"help", no_argument, NULL, 'h'},
+	{NULL, 0, NULL, 0},
+};
+
+static void bench_usage(const char *argv0) {
+	fprintf(
+		stderr,
+		"Usage: %s [options] <command> <host>\n"
+		"\n"
+		"Commands:\n"
+		"  data                   RX/TX throughput and latency through PTY pairs\n"
+		"  control                round-trip time of control requests and stdmsg actions\n"
+		"\n"
+		"Options:\n"
+		"  -d, --duration <ms>    length of every run (default: 2000)\n"
+		"  -c, --chunks <list>    comma-separated chunk sizes (default: 1,64,1024,16384)\n"
+		"  -p, --ports <list>     comma-separated port counts (default: 1,4)\n"
+		"  -w, --rx-window <n>    enable RX flow control with this many credits (default: off)\n"
+		"  -i, --interval-us <n>  pacing of the latency runs (default: 1000)\n"
+		"  -P, --ws-port <port>   the host's WebSocket port (default: 23290)\n"
+		"  -n, --ops <n>          requests per control operation (default: 1000)\n"
+		"\n"
+		"Results are printed to stdout as JSON, progress to stderr.\n",
+		argv0
+	);
+}
+
+static bool bench_parse_list(const char *arg, uint32_t **list, int *len) {
+	free(*list);
+	*list = NULL;
+	*len  = 0;
+	for (const char *value = arg; *value != '\0';) {
+		char *end;
+		unsigned long number = strtoul(value, &end, 0);
+		if (end == value || number == 0 || number > UINT32_MAX)
+			return false;
+		uint32_t *items = realloc(*list, (*len + 1) * sizeof(**list));
+		if (items == NULL)
+			return false;
+		*list			= items;
+		(*list)[(*len)++] = number;
+		value			  = *end == ',' ? end + 1 : end;
+		if (*end != ',' && *end != '\0')
+			return false;
+	}
+	return *len != 0;
+}
+
+int main(int argc, char *argv[]) {
+	bench_options_t options = {
+		.ws_port	 = 23290,
+		.duration_ms = 2000,
+		.rx_window	 = 0,
+		.interval_us = 1000,
+		.ops		 = 1000,
+	};
+	bench_parse_list("1,64,1024,16384", &options.chunks, &options.chunks_len);
+	bench_parse_list("1,4", &options.ports, &options.ports_len);
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "d:c:p:w:i:P:n:h", bench_long_options, NULL)) != -1) {
+		bool ok = true;
+		switch (opt) {
+			case 'd':
+				ok = (options.duration_ms = strtoul(optarg, NULL, 0)) != 0;
+				break;
+			case 'c':
+				ok = bench_parse_list(optarg, &options.chunks, &options.chunks_len);
+				break;
+			case 'p':
+				ok = bench_parse_list(optarg, &options.ports, &options.ports_len);
+				break;
+			case 'w':
+				options.rx_window = strtoul(optarg, NULL, 0);
+				break;
+			case 'i':
+				ok = (options.interval_us = strtoul(optarg, NULL, 0)) != 0;
+				break;
+			case 'P':
+				ok = (options.ws_port = atoi(optarg)) > 0;
+				break;
+			case 'n':
+				ok = (options.ops = strtoul(optarg, NULL, 0)) != 0;
+				break;
+			default:
+				ok = false;
+				break;
+		}
+		if (!ok) {
+			bench_usage(argv[0]);
+			return 2;
+		}
+	}
+	if (argc - optind != 2) {
+		bench_usage(argv[0]);
+		return 2;
+	}
+	const char *command = argv[optind];
+	options.host_path	= argv[optind + 1];
+
+	int ret;
+	if (strcmp(command, "data") == 0) {
+		ret = bench_data(&options);
+	} else if (strcmp(command, "control") == 0) {
+		ret = bench_control(&options);
+	} else {
+		bench_usage(argv[0]);
+		ret = 2;
+	}
+
+	free(options.chunks);
+	free(options.ports);
+	return ret;
+}
@@ -2,7 +2,12 @@ import sys
 
 Import("env")
 
-env.Replace(PROGNAME="firefox-webserial")
+if env["PIOENV"].startswith("bench_enum_"):
+    env.Replace(PROGNAME="firefox-webserial-bench-enum")
+elif env["PIOENV"].startswith("bench_"):
+    env.Replace(PROGNAME="firefox-webserial-bench")
+else:
+    env.Replace(PROGNAME="firefox-webserial")
 
 # Add macOS framework linkage
 if sys.platform == "darwin":
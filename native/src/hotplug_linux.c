@@ -0,0 +1,102 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#ifdef __linux__
+
+#include "serial.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+// wait for a burst of uevents to settle before enumerating the ports
+#define HOTPLUG_SETTLE_MS 100
+// size of a single uevent message
+#define HOTPLUG_BUF_SIZE  4096
+
+static int hotplug_fd			= -1;
+static pthread_t hotplug_thread = 0;
+
+static bool hotplug_is_tty(const char *msg, int len) {
+	// "ACTION@DEVPATH", followed by "KEY=VALUE" strings
+	bool is_tty	   = false;
+	bool is_change = false;
+	for (int i = 0; i < len; i += strlen(msg + i) + 1) {
+		const char *field = msg + i;
+		if (strcmp(field, "SUBSYSTEM=tty") == 0)
+			is_tty = true;
+		else if (strcmp(field, "ACTION=add") == 0 || strcmp(field, "ACTION=remove") == 0)
+			is_change = true;
+	}
+	return is_tty && is_change;
+}
+
+static void *hotplug_run(void *arg) {
+	stdmsg_send_debug("Hotplug thread running");
+
+	char msg[HOTPLUG_BUF_SIZE];
+	struct pollfd pfd = {
+		.fd		= hotplug_fd,
+		.events = POLLIN,
+	};
+	bool pending = false;
+
+	while (1) {
+		int count = poll(&pfd, 1, pending ? HOTPLUG_SETTLE_MS : -1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (count == 0) {
+			// no more events for a while
+			pending = false;
+			serial_ports_changed();
+			continue;
+		}
+
+		int len = recv(hotplug_fd, msg, sizeof(msg) - 1, 0);
+		if (len < 0) {
+			// some events were lost - enumerate the ports anyway
+			if (errno == ENOBUFS)
+				pending = true;
+			else if (errno != EINTR)
+				break;
+			continue;
+		}
+		msg[len] = '\0';
+		if (hotplug_is_tty(msg, len))
+			pending = true;
+	}
+
+	// the cached port list can't be trusted anymore
+	serial_ports_unwatched();
+	close(hotplug_fd);
+	hotplug_fd = -1;
+	stdmsg_send_debug("Hotplug thread finished");
+	return NULL;
+}
+
+bool serial_hotplug_start() {
+	if ((hotplug_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT)) == -1)
+		return false;
+
+	// receive kernel uevents
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_pid	   = 0,
+		.nl_groups = 1,
+	};
+	if (bind(hotplug_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+		goto error;
+	if (!utils_thread_create(&hotplug_thread, hotplug_run, NULL))
+		goto error;
+	return true;
+
+error:
+	close(hotplug_fd);
+	hotplug_fd = -1;
+	return false;
+}
+
+#endif
@@ -6,7 +6,9 @@
 #include <libserialport.h>
 #include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,6 +19,9 @@
 
 #include "webserial_config.h"
 
+#include "json.h"
+#include "ring.h"
 #include "serial.h"
 #include "stdmsg.h"
+#include "utils.h"
 #include "websocket.h"
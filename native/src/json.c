@@ -0,0 +1,228 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "json.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static pthread_once_t json_once = PTHREAD_ONCE_INIT;
+static pthread_key_t json_key;
+
+static void json_writer_free(void *arg) {
+	json_writer_t *writer = arg;
+	free(writer->buf);
+	free(writer);
+}
+
+static void json_key_create() {
+	pthread_key_create(&json_key, json_writer_free);
+}
+
+static bool json_reserve(json_writer_t *writer, uint32_t len) {
+	if (writer->error)
+		return false;
+	if (writer->len + len <= writer->size)
+		return true;
+	uint32_t size = writer->size;
+	while (size < writer->len + len) {
+		size *= 2;
+	}
+	char *buf = realloc(writer->buf, size);
+	if (buf == NULL) {
+		writer->error = true;
+		return false;
+	}
+	writer->buf	 = buf;
+	writer->size = size;
+	return true;
+}
+
+static void json_append(json_writer_t *writer, const char *data, uint32_t len) {
+	if (!json_reserve(writer, len))
+		return;
+	memcpy(writer->buf + writer->len, data, len);
+	writer->len += len;
+}
+
+static void json_append_escaped(json_writer_t *writer, const char *str) {
+	static const char HEX[] = "0123456789abcdef";
+	json_append(writer, "\"", 1);
+	while (*str) {
+		// copy everything up to the next character that needs escaping
+		const char *start = str;
+		while (*str && *str != '"' && *str != '\\' && (uint8_t)*str >= 0x20) {
+			str++;
+		}
+		json_append(writer, start, str - start);
+		if (*str == '\0')
+			break;
+		char escape[6] = {'\\', *str, 0, 0, 0, 0};
+		int escape_len = 2;
+		switch (*str) {
+			case '"':
+			case '\\':
+				break;
+			case '\b':
+				escape[1] = 'b';
+				break;
+			case '\f':
+				escape[1] = 'f';
+				break;
+			case '\n':
+				escape[1] = 'n';
+				break;
+			case '\r':
+				escape[1] = 'r';
+				break;
+			case '\t':
+				escape[1] = 't';
+				break;
+			default:
+				escape[1]  = 'u';
+				escape[2]  = '0';
+				escape[3]  = '0';
+				escape[4]  = HEX[(uint8_t)*str >> 4];
+				escape[5]  = HEX[*str & 0xF];
+				escape_len = 6;
+				break;
+		}
+		json_append(writer, escape, escape_len);
+		str++;
+	}
+	json_append(writer, "\"", 1);
+}
+
+static uint64_t json_depth_bit(json_writer_t *writer) {
+	// nesting deeper than that is an error already, and shifting by 64 bits is undefined
+	if (writer->depth >= JSON_WRITER_DEPTH)
+		return 0;
+	return 1ull << writer->depth;
+}
+
+static void json_add_key(json_writer_t *writer, const char *key) {
+	uint64_t bit = json_depth_bit(writer);
+	if (writer->has_items & bit)
+		json_append(writer, ",", 1);
+	writer->has_items |= bit;
+	if (key == NULL)
+		return;
+	json_append_escaped(writer, key);
+	json_append(writer, ":", 1);
+}
+
+static void json_nest(json_writer_t *writer, const char *key, char open) {
+	json_add_key(writer, key);
+	json_append(writer, &open, 1);
+	// the depth still counts, so that the closing calls stay balanced
+	if (++writer->depth >= JSON_WRITER_DEPTH)
+		writer->error = true;
+	writer->has_items &= ~json_depth_bit(writer);
+}
+
+json_writer_t *json_writer_begin() {
+	pthread_once(&json_once, json_key_create);
+	json_writer_t *writer = pthread_getspecific(json_key);
+	if (writer == NULL) {
+		// allocated once per thread, reused for every message
+		if ((writer = calloc(1, sizeof(*writer))) == NULL)
+			return NULL;
+		if ((writer->buf = malloc(JSON_WRITER_SIZE)) == NULL) {
+			free(writer);
+			return NULL;
+		}
+		writer->size = JSON_WRITER_SIZE;
+		pthread_setspecific(json_key, writer);
+	}
+	// don't overwrite a message that this thread didn't finish yet
+	if (writer->busy)
+		return NULL;
+	writer->busy = true;
+	// leave room for the length prefix
+	writer->len		  = sizeof(uint32_t);
+	writer->depth	  = 0;
+	writer->has_items = 0;
+	writer->error	  = false;
+	json_append(writer, "{", 1);
+	writer->depth++;
+	return writer;
+}
+
+uint32_t json_writer_end(json_writer_t *writer) {
+	json_object_end(writer);
+	writer->busy = false;
+	if (writer->error)
+		return 0;
+	uint32_t len = writer->len - sizeof(uint32_t);
+	memcpy(writer->buf, &len, sizeof(uint32_t));
+	return writer->len;
+}
+
+void json_object_begin(json_writer_t *writer, const char *key) {
+	json_nest(writer, key, '{');
+}
+
+void json_object_end(json_writer_t *writer) {
+	writer->depth--;
+	json_append(writer, "}", 1);
+}
+
+void json_array_begin(json_writer_t *writer, const char *key) {
+	json_nest(writer, key, '[');
+}
+
+void json_array_end(json_writer_t *writer) {
+	writer->depth--;
+	json_append(writer, "]", 1);
+}
+
+void json_add_string(json_writer_t *writer, const char *key, const char *value) {
+	if (value == NULL) {
+		json_add_null(writer, key);
+		return;
+	}
+	json_add_key(writer, key);
+	json_append_escaped(writer, value);
+}
+
+void json_add_int(json_writer_t *writer, const char *key, int64_t value) {
+	char number[24];
+	int len = snprintf(number, sizeof(number), "%lld", (long long)value);
+	json_add_key(writer, key);
+	json_append(writer, number, len);
+}
+
+void json_add_bool(json_writer_t *writer, const char *key, bool value) {
+	json_add_key(writer, key);
+	if (value)
+		json_append(writer, "true", 4);
+	else
+		json_append(writer, "false", 5);
+}
+
+void json_add_null(json_writer_t *writer, const char *key) {
+	json_add_key(writer, key);
+	json_append(writer, "null", 4);
+}
+
+void json_add_raw(json_writer_t *writer, const char *key, const char *raw) {
+	json_add_key(writer, key);
+	json_append(writer, raw, strlen(raw));
+}
+
+void json_add_cjson(json_writer_t *writer, const char *key, const cJSON *item) {
+	json_add_key(writer, key);
+	// print directly into the buffer, growing it until the item fits
+	uint32_t space = JSON_WRITER_SIZE;
+	while (space <= JSON_WRITER_MAX && json_reserve(writer, space)) {
+		// cJSON needs a few bytes more than it prints
+		int size = writer->size - writer->len;
+		if (cJSON_PrintPreallocated((cJSON *)item, writer->buf + writer->len, size, false)) {
+			writer->len += strlen(writer->buf + writer->len);
+			return;
+		}
+		space = size * 2;
+	}
+	writer->error = true;
+}
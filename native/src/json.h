@@ -0,0 +1,39 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#pragma once
+
+#include <cJSON.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// initial size of a thread's JSON buffer; it only grows if a message doesn't fit
+#define JSON_WRITER_SIZE  4096
+// maximum size of a single message
+#define JSON_WRITER_MAX	  (16 * 1024 * 1024)
+// maximum nesting of JSON objects and arrays
+#define JSON_WRITER_DEPTH 64
+
+typedef struct {
+	char *buf;			// length-prefixed message being written
+	uint32_t len;		// length of the message, including the prefix
+	uint32_t size;		// allocated size of the buffer
+	uint32_t depth;		// current nesting level
+	uint64_t has_items; // bit per nesting level - a value was already written there
+	bool error;			// out of memory, the message is incomplete
+	bool busy;			// a message is being written
+} json_writer_t;
+
+json_writer_t *json_writer_begin();
+uint32_t json_writer_end(json_writer_t *writer);
+
+void json_object_begin(json_writer_t *writer, const char *key);
+void json_object_end(json_writer_t *writer);
+void json_array_begin(json_writer_t *writer, const char *key);
+void json_array_end(json_writer_t *writer);
+
+void json_add_string(json_writer_t *writer, const char *key, const char *value);
+void json_add_int(json_writer_t *writer, const char *key, int64_t value);
+void json_add_bool(json_writer_t *writer, const char *key, bool value);
+void json_add_null(json_writer_t *writer, const char *key);
+void json_add_raw(json_writer_t *writer, const char *key, const char *raw);
+void json_add_cjson(json_writer_t *writer, const char *key, const cJSON *item);
@@ -3,6 +3,7 @@
 #include "include.h"
 
 int main(void) {
+	stdmsg_start();
 	websocket_start();
 
 	while (true) {
@@ -11,9 +12,11 @@ int main(void) {
 			break;
 		if (ret < 0) {
 			printf("ERROR %d\n", ret);
+			stdmsg_flush();
 			return -ret;
 		}
 	}
 
+	stdmsg_flush();
 	return 0;
 }
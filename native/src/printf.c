@@ -3,28 +3,13 @@
 #include "include.h"
 
 int __wrap___mingw_vprintf(const char *format, va_list argv) {
-	uint32_t len = vsnprintf(NULL, 0, format, argv);
-
-	char *buf = malloc(len + 1);
-	int ret	  = vsprintf(buf, format, argv);
-
-	stdmsg_send_log(buf);
-	free(buf);
-
-	return ret;
+	return stdmsg_send_log_v(STDMSG_INFO, format, argv);
 }
 
 int __wrap_printf(const char *format, ...) {
 	va_list argv;
 	va_start(argv, format);
-	uint32_t len = vsnprintf(NULL, 0, format, argv);
+	int ret = stdmsg_send_log_v(STDMSG_INFO, format, argv);
 	va_end(argv);
-
-	char *buf = malloc(len + 1);
-	int ret	  = vsprintf(buf, format, argv);
-
-	stdmsg_send_log(buf);
-	free(buf);
-
 	return ret;
 }
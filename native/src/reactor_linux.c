@@ -0,0 +1,148 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#ifdef __linux__
+
+#include "serial.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+
+#define REACTOR_MAX_EVENTS 64
+
+static int reactor_fd				 = -1;
+static pthread_t reactor_thread		 = 0;
+static pthread_mutex_t reactor_mutex = PTHREAD_MUTEX_INITIALIZER;
+static serial_port_t **reactor_ports = NULL;
+static int reactor_ports_len		 = 0;
+static int reactor_ports_size		 = 0;
+
+static int reactor_find(serial_port_t *serial) {
+	for (int i = 0; i < reactor_ports_len; i++) {
+		if (reactor_ports[i] == serial)
+			return i;
+	}
+	return -1;
+}
+
+static void reactor_drop(serial_port_t *serial) {
+	int index = reactor_find(serial);
+	if (index < 0)
+		return;
+	int fd;
+	if (sp_get_port_handle(serial->port, &fd) == SP_OK)
+		epoll_ctl(reactor_fd, EPOLL_CTL_DEL, fd, NULL);
+	reactor_ports[index] = reactor_ports[--reactor_ports_len];
+}
+
+static void reactor_update(serial_port_t *serial) {
+	// stop polling the port while the page is out of credits, or the RX ring is full
+	bool paused = !websocket_serial_can_read(serial);
+	if (paused == serial->rx_paused)
+		return;
+	int fd;
+	if (sp_get_port_handle(serial->port, &fd) != SP_OK)
+		return;
+	struct epoll_event event = {
+		.events	  = paused ? 0 : EPOLLIN,
+		.data.ptr = serial,
+	};
+	if (epoll_ctl(reactor_fd, EPOLL_CTL_MOD, fd, &event) == 0)
+		serial->rx_paused = paused;
+}
+
+static void *reactor_run(void *arg) {
+	stdmsg_send_debug("Reactor thread running");
+
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+
+	while (1) {
+		// coalescing deadlines are up to the ports' sender threads
+		int count = epoll_wait(reactor_fd, events, REACTOR_MAX_EVENTS, -1);
+		if (count < 0 && errno != EINTR)
+			break;
+		// when the data arrived, as far as the page is concerned
+		uint64_t time_us = utils_time_us();
+
+		pthread_mutex_lock(&reactor_mutex);
+		for (int i = 0; i < count; i++) {
+			serial_port_t *serial = events[i].data.ptr;
+			// skip ports removed after epoll_wait() returned
+			if (reactor_find(serial) < 0)
+				continue;
+			SERIAL_STATS_ADD(serial, wait_wakeups, 1);
+			if ((events[i].events & (EPOLLERR | EPOLLHUP)) || !websocket_serial_read(serial, time_us)) {
+				websocket_serial_error(serial);
+				reactor_drop(serial);
+				continue;
+			}
+			reactor_update(serial);
+		}
+		pthread_mutex_unlock(&reactor_mutex);
+	}
+
+	stdmsg_send_debug("Reactor thread finished");
+	return NULL;
+}
+
+bool serial_reactor_add(serial_port_t *serial) {
+	int fd;
+	if (sp_get_port_handle(serial->port, &fd) != SP_OK)
+		return false;
+
+	bool ret = false;
+	pthread_mutex_lock(&reactor_mutex);
+
+	if (reactor_fd == -1) {
+		if ((reactor_fd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+			goto end;
+		if (!utils_thread_create(&reactor_thread, reactor_run, NULL)) {
+			close(reactor_fd);
+			reactor_fd = -1;
+			goto end;
+		}
+	}
+
+	if (reactor_ports_len == reactor_ports_size) {
+		int size			  = reactor_ports_size ? reactor_ports_size * 2 : 16;
+		serial_port_t **ports = realloc(reactor_ports, size * sizeof(*ports));
+		if (ports == NULL)
+			goto end;
+		reactor_ports	   = ports;
+		reactor_ports_size = size;
+	}
+
+	struct epoll_event event = {
+		.events	  = EPOLLIN,
+		.data.ptr = serial,
+	};
+	if (epoll_ctl(reactor_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+		goto end;
+	reactor_ports[reactor_ports_len++] = serial;
+	serial->rx_paused				   = false;
+	ret								   = true;
+
+end:
+	pthread_mutex_unlock(&reactor_mutex);
+	return ret;
+}
+
+void serial_reactor_remove(serial_port_t *serial) {
+	// once this returns, the reactor is not touching the port anymore
+	pthread_mutex_lock(&reactor_mutex);
+	if (serial->port != NULL)
+		reactor_drop(serial);
+	pthread_mutex_unlock(&reactor_mutex);
+}
+
+pthread_t serial_reactor_get_thread() {
+	return reactor_thread;
+}
+
+void serial_reactor_update(serial_port_t *serial) {
+	pthread_mutex_lock(&reactor_mutex);
+	if (reactor_find(serial) >= 0)
+		reactor_update(serial);
+	pthread_mutex_unlock(&reactor_mutex);
+}
+
+#endif
@@ -0,0 +1,104 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	_Atomic uint32_t seq; // slot's position when free, position + 1 when written
+	uint32_t len;		  // length of the data
+	uint8_t data[];
+} ring_slot_t;
+
+static ring_slot_t *ring_slot(ring_t *ring, uint32_t pos) {
+	return (ring_slot_t *)(ring->slots + (size_t)(pos & ring->mask) * ring->slot_size);
+}
+
+bool ring_init(ring_t *ring, uint32_t count, uint32_t data_size) {
+	// keep the headers aligned
+	uint32_t slot_size = (sizeof(ring_slot_t) + data_size + 7) & ~7;
+	if (count == 0 || (count & (count - 1)) != 0)
+		return false;
+	if ((ring->slots = malloc((size_t)count * slot_size)) == NULL)
+		return false;
+	ring->slot_size = slot_size;
+	ring->mask		= count - 1;
+	ring->tail		= 0;
+	atomic_init(&ring->head, 0);
+	for (uint32_t i = 0; i < count; i++) {
+		atomic_init(&ring_slot(ring, i)->seq, i);
+	}
+	return true;
+}
+
+void ring_free(ring_t *ring) {
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+void *ring_reserve(ring_t *ring, uint32_t *pos) {
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	while (1) {
+		ring_slot_t *slot = ring_slot(ring, head);
+		uint32_t seq	  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		int32_t diff	  = (int32_t)(seq - head);
+		if (diff == 0) {
+			// the slot is free - try to claim it
+			if (atomic_compare_exchange_weak_explicit(
+					&ring->head,
+					&head,
+					head + 1,
+					memory_order_relaxed,
+					memory_order_relaxed
+				)) {
+				*pos = head;
+				return slot->data;
+			}
+		} else if (diff < 0) {
+			// the consumer didn't read this slot yet
+			return NULL;
+		} else {
+			// another producer claimed it
+			head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+		}
+	}
+}
+
+void ring_commit(ring_t *ring, uint32_t pos, uint32_t len) {
+	ring_slot_t *slot = ring_slot(ring, pos);
+	slot->len		  = len;
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+bool ring_push(ring_t *ring, const void *data, uint32_t len) {
+	if (len > ring->slot_size - sizeof(ring_slot_t))
+		return false;
+	uint32_t pos;
+	void *slot = ring_reserve(ring, &pos);
+	if (slot == NULL)
+		return false;
+	memcpy(slot, data, len);
+	ring_commit(ring, pos, len);
+	return true;
+}
+
+const void *ring_peek(ring_t *ring, uint32_t *len) {
+	ring_slot_t *slot = ring_slot(ring, ring->tail);
+	uint32_t seq	  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+	if (seq != ring->tail + 1)
+		return NULL;
+	*len = slot->len;
+	return slot->data;
+}
+
+void ring_pop(ring_t *ring) {
+	ring_slot_t *slot = ring_slot(ring, ring->tail);
+	// free the slot for the producers' next lap
+	atomic_store_explicit(&slot->seq, ring->tail + ring->mask + 1, memory_order_release);
+	ring->tail++;
+}
+
+bool ring_is_empty(ring_t *ring) {
+	return atomic_load_explicit(&ring->head, memory_order_acquire) == ring->tail;
+}
@@ -0,0 +1,27 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// bounded lock-free queue of fixed-size slots; any number of producers, a single consumer
+typedef struct {
+	uint8_t *slots;		   // 'count' slots of 'slot_size' bytes
+	uint32_t slot_size;	   // size of a slot, including its header
+	uint32_t mask;		   // number of slots - 1 (a power of two)
+	_Atomic uint32_t head; // next slot claimed by a producer
+	uint32_t tail;		   // next slot read by the consumer
+} ring_t;
+
+bool ring_init(ring_t *ring, uint32_t count, uint32_t data_size);
+void ring_free(ring_t *ring);
+
+void *ring_reserve(ring_t *ring, uint32_t *pos);
+void ring_commit(ring_t *ring, uint32_t pos, uint32_t len);
+bool ring_push(ring_t *ring, const void *data, uint32_t len);
+
+const void *ring_peek(ring_t *ring, uint32_t *len);
+void ring_pop(ring_t *ring);
+bool ring_is_empty(ring_t *ring);
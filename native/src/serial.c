@@ -8,10 +8,206 @@ static const char *SP_TRANSPORT_STR[] = {
 	[SP_TRANSPORT_BLUETOOTH] = "BLUETOOTH",
 };
 
-static serial_port_t *port_arr = NULL;
-static int port_arr_len		   = 0;
+const char *serial_transport_to_str(enum sp_transport transport) {
+	return SP_TRANSPORT_STR[transport];
+}
+
+int serial_transport_from_str(const char *transport) {
+	for (int i = 0; transport != NULL && i < sizeof(SP_TRANSPORT_STR) / sizeof(*SP_TRANSPORT_STR); i++) {
+		if (strcmp(transport, SP_TRANSPORT_STR[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+// ports are allocated in chunks that never move, so that pointers stay valid forever
+static serial_port_t **port_chunks = NULL;
+static int port_chunks_len		   = 0;
+static int port_count			   = 0;
+// hash indexes of the ports, by auth key, connection and port name
+static serial_port_t *port_by_auth[SERIAL_HASH_SIZE];
+static serial_port_t *port_by_conn[SERIAL_HASH_SIZE];
+static serial_port_t *port_by_name[SERIAL_HASH_SIZE];
+// subscribers of shared ports, by connection
+static serial_subscriber_t *sub_by_conn[SERIAL_HASH_SIZE];
+// protects the indexes and the ports' auth_key and conn fields
+static pthread_rwlock_t port_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static uint32_t serial_hash_str(const char *str) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	while (*str) {
+		hash ^= (uint8_t)*str++;
+		hash *= 16777619u;
+	}
+	return hash % SERIAL_HASH_SIZE;
+}
+
+static uint32_t serial_hash_ptr(const void *ptr) {
+	uint64_t hash = (uintptr_t)ptr;
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDull;
+	hash ^= hash >> 33;
+	return hash % SERIAL_HASH_SIZE;
+}
+
+static void serial_unlink(serial_port_t **bucket, serial_port_t *serial, size_t next_offset) {
+	serial_port_t **link = bucket;
+	while (*link != NULL) {
+		serial_port_t **next = (serial_port_t **)((char *)*link + next_offset);
+		if (*link == serial) {
+			*link = *next;
+			*next = NULL;
+			return;
+		}
+		link = next;
+	}
+}
+
+static serial_port_t *serial_alloc() {
+	int chunk = port_count / SERIAL_CHUNK_SIZE;
+	if (chunk == port_chunks_len) {
+		serial_port_t **chunks = realloc(port_chunks, (port_chunks_len + 1) * sizeof(*chunks));
+		if (chunks == NULL)
+			return NULL;
+		port_chunks = chunks;
+		if ((port_chunks[chunk] = calloc(SERIAL_CHUNK_SIZE, sizeof(serial_port_t))) == NULL)
+			return NULL;
+		port_chunks_len++;
+	}
+	return &port_chunks[chunk][port_count++ % SERIAL_CHUNK_SIZE];
+}
+
+static serial_port_t *serial_find_by_name(const char *port_name) {
+	serial_port_t *serial = port_by_name[serial_hash_str(port_name)];
+	while (serial != NULL && strcmp(port_name, serial->port_name) != 0) {
+		serial = serial->name_next;
+	}
+	return serial;
+}
+
+void serial_set_conn(serial_port_t *serial, ws_cli_conn_t *conn) {
+	pthread_rwlock_wrlock(&port_lock);
+	if (serial->conn != NULL)
+		serial_unlink(&port_by_conn[serial_hash_ptr(serial->conn)], serial, offsetof(serial_port_t, conn_next));
+	serial->conn = conn;
+	if (conn != NULL) {
+		uint32_t hash	   = serial_hash_ptr(conn);
+		serial->conn_next  = port_by_conn[hash];
+		port_by_conn[hash] = serial;
+	}
+	pthread_rwlock_unlock(&port_lock);
+}
+
+void serial_port_get_details(struct sp_port *port, serial_port_details_t *details) {
+	memset(details, 0, sizeof(*details));
+	details->name			   = sp_get_port_name(port);
+	details->transport		   = sp_get_port_transport(port);
+	details->usb_bus		   = -1;
+	details->usb_address	   = -1;
+	details->usb_vid		   = -1;
+	details->usb_pid		   = -1;
+	details->description	   = sp_get_port_description(port);
+	details->bluetooth_address = sp_get_port_bluetooth_address(port);
+	if (details->transport != SP_TRANSPORT_USB)
+		return;
+	if (sp_get_port_usb_bus_address(port, &details->usb_bus, &details->usb_address) != SP_OK) {
+		details->usb_bus	 = -1;
+		details->usb_address = -1;
+	}
+	if (sp_get_port_usb_vid_pid(port, &details->usb_vid, &details->usb_pid) != SP_OK) {
+		details->usb_vid = -1;
+		details->usb_pid = -1;
+	}
+	details->usb_manufacturer = sp_get_port_usb_manufacturer(port);
+	details->usb_product	  = sp_get_port_usb_product(port);
+	details->usb_serial		  = sp_get_port_usb_serial(port);
+}
+
+cJSON *serial_port_details_to_json(const serial_port_details_t *details, const char *id, const char *description) {
+	cJSON *item = cJSON_CreateObject();
+	if (item == NULL)
+		return NULL;
+
+	cJSON_AddStringToObject(item, "id", id);
+	cJSON_AddStringToObject(item, "name", details->name);
+	cJSON_AddStringToObject(item, "transport", serial_transport_to_str(details->transport));
+	cJSON_AddStringToObject(item, "description", description);
+
+	switch (details->transport) {
+		case SP_TRANSPORT_NATIVE:
+			break;
+
+		case SP_TRANSPORT_USB: {
+			cJSON *usb = cJSON_CreateObject();
+			if (usb == NULL)
+				goto error;
+			if (cJSON_AddItemToObject(item, "usb", usb) == 0) {
+				cJSON_Delete(usb);
+				goto error;
+			}
+
+			if (details->usb_bus >= 0 && details->usb_address >= 0) {
+				cJSON_AddNumberToObject(usb, "bus", details->usb_bus);
+				cJSON_AddNumberToObject(usb, "address", details->usb_address);
+			}
+			if (details->usb_vid >= 0 && details->usb_pid >= 0) {
+				cJSON_AddNumberToObject(usb, "vid", details->usb_vid);
+				cJSON_AddNumberToObject(usb, "pid", details->usb_pid);
+			}
+			// a NULL string isn't added at all
+			cJSON_AddStringToObject(usb, "manufacturer", details->usb_manufacturer);
+			cJSON_AddStringToObject(usb, "product", details->usb_product);
+			cJSON_AddStringToObject(usb, "serial", details->usb_serial);
+			break;
+		}
+
+		case SP_TRANSPORT_BLUETOOTH: {
+			cJSON *bluetooth = cJSON_CreateObject();
+			if (bluetooth == NULL)
+				goto error;
+			if (cJSON_AddItemToObject(item, "bluetooth", bluetooth) == 0) {
+				cJSON_Delete(bluetooth);
+				goto error;
+			}
+
+			cJSON_AddStringToObject(bluetooth, "address", details->bluetooth_address);
+			break;
+		}
+	}
+
+	return item;
+
+error:
+	cJSON_Delete(item);
+	return NULL;
+}
+
+cJSON *serial_port_to_json(struct sp_port *port) {
+	char *id = serial_port_get_id(port);
+	if (serial_port_fix_details != NULL)
+		serial_port_fix_details(port, id);
+	// read after fixing them
+	serial_port_details_t details;
+	serial_port_get_details(port, &details);
+
+	cJSON *item;
+	if (serial_port_get_description != NULL) {
+		char *description = serial_port_get_description(port);
+		item			  = serial_port_details_to_json(&details, id, description);
+		free(description);
+	} else {
+		item = serial_port_details_to_json(&details, id, details.description);
+	}
+	free(id);
+	return item;
+}
+
+cJSON *serial_list_ports_json(const serial_filter_t *filters, int filters_len) {
+	// enumerate the ports with the filters applied early, if the platform can do it
+	if (serial_list_ports_platform != NULL)
+		return serial_list_ports_platform(filters, filters_len);
 
-cJSON *serial_list_ports_json() {
 	struct sp_port **ports = NULL;
 	if (sp_list_ports(&ports) != SP_OK)
 		return NULL;
@@ -21,83 +217,13 @@ cJSON *serial_list_ports_json() {
 		goto end;
 
 	for (int i = 0; ports[i] != NULL; i++) {
-		struct sp_port *port = ports[i];
-
-		cJSON *item = cJSON_CreateObject();
+		cJSON *item = serial_port_to_json(ports[i]);
 		if (item == NULL)
 			goto end;
-
-		char *id = serial_port_get_id(port);
-		if (serial_port_fix_details != NULL)
-			serial_port_fix_details(port, id);
-		cJSON_AddStringToObject(item, "id", id);
-		free(id);
-
-		const char *name = sp_get_port_name(port);
-		cJSON_AddStringToObject(item, "name", name);
-		enum sp_transport transport = sp_get_port_transport(port);
-		cJSON_AddStringToObject(item, "transport", SP_TRANSPORT_STR[transport]);
-
-		if (serial_port_get_description != NULL) {
-			char *description = serial_port_get_description(port);
-			cJSON_AddStringToObject(item, "description", description);
-			free(description);
-		} else {
-			const char *description = sp_get_port_description(port);
-			cJSON_AddStringToObject(item, "description", description);
-		}
-
-		switch (transport) {
-			case SP_TRANSPORT_NATIVE:
-				break;
-
-			case SP_TRANSPORT_USB: {
-				cJSON *usb = cJSON_CreateObject();
-				if (usb == NULL)
-					goto end;
-				if (cJSON_AddItemToObject(item, "usb", usb) == 0) {
-					cJSON_Delete(usb);
-					goto end;
-				}
-
-				int bus		= 0;
-				int address = 0;
-				if (sp_get_port_usb_bus_address(port, &bus, &address) == SP_OK) {
-					cJSON_AddNumberToObject(usb, "bus", bus);
-					cJSON_AddNumberToObject(usb, "address", address);
-				}
-
-				int vid = 0;
-				int pid = 0;
-				if (sp_get_port_usb_vid_pid(port, &vid, &pid) == SP_OK) {
-					cJSON_AddNumberToObject(usb, "vid", vid);
-					cJSON_AddNumberToObject(usb, "pid", pid);
-				}
-
-				const char *manufacturer = sp_get_port_usb_manufacturer(port);
-				cJSON_AddStringToObject(usb, "manufacturer", manufacturer);
-				const char *product = sp_get_port_usb_product(port);
-				cJSON_AddStringToObject(usb, "product", product);
-				const char *serial = sp_get_port_usb_serial(port);
-				cJSON_AddStringToObject(usb, "serial", serial);
-				break;
-			}
-
-			case SP_TRANSPORT_BLUETOOTH: {
-				cJSON *bluetooth = cJSON_CreateObject();
-				if (bluetooth == NULL)
-					goto end;
-				if (cJSON_AddItemToObject(item, "bluetooth", bluetooth) == 0) {
-					cJSON_Delete(bluetooth);
-					goto end;
-				}
-
-				const char *address = sp_get_port_bluetooth_address(port);
-				cJSON_AddStringToObject(bluetooth, "address", address);
-				break;
-			}
+		if (!serial_filter_match_json(filters, filters_len, item)) {
+			cJSON_Delete(item);
+			continue;
 		}
-
 		cJSON_AddItemToArray(data, item);
 	}
 
@@ -110,7 +236,7 @@ end:
 	return NULL;
 }
 
-static char *serial_auth_make_key(const char *port_name) {
+char *serial_auth_make_key(const char *port_name) {
 	UUID4_STATE_T state;
 	UUID4_T uuid;
 	uuid4_seed(&state);
@@ -122,96 +248,433 @@ static char *serial_auth_make_key(const char *port_name) {
 	return auth_key;
 }
 
+static bool serial_auth_set_key(serial_port_t *serial) {
+	if ((serial->auth_key = serial_auth_make_key(serial->port_name)) == NULL)
+		return false;
+	uint32_t hash	   = serial_hash_str(serial->auth_key);
+	serial->auth_next  = port_by_auth[hash];
+	port_by_auth[hash] = serial;
+	return true;
+}
+
 const char *serial_auth_grant(const char *port_name) {
-	serial_port_t *serial = port_arr;
-	for (int i = 0; i < port_arr_len; i++, serial++) {
-		if (strcmp(port_name, serial->port_name) == 0) {
-			if (serial->auth_key == NULL)
-				serial->auth_key = serial_auth_make_key(port_name);
-			return serial->auth_key;
-		}
+	const char *auth_key = NULL;
+	pthread_rwlock_wrlock(&port_lock);
+
+	serial_port_t *serial = serial_find_by_name(port_name);
+	if (serial != NULL) {
+		if (serial->auth_key == NULL)
+			serial_auth_set_key(serial);
+		auth_key = serial->auth_key;
+		goto end;
 	}
 
-	serial_port_t *prev = port_arr;
-	port_arr			= realloc(port_arr, ++port_arr_len * sizeof(serial_port_t));
-	if (port_arr == NULL) {
-		free(prev);
-		return NULL;
+	if ((serial = serial_alloc()) == NULL)
+		goto end;
+	if ((serial->port_name = strdup(port_name)) == NULL) {
+		// the entry stays unused
+		goto end;
 	}
+	uint32_t hash	   = serial_hash_str(port_name);
+	serial->name_next  = port_by_name[hash];
+	port_by_name[hash] = serial;
+
+	serial->port			   = NULL;
+	serial->conn			   = NULL;
+	serial->thread			   = 0;
+	serial->event_set		   = NULL;
+	serial->reader_priority	   = 0;
+	serial->reader_cpu		   = -1;
+	serial->rx.buf			   = NULL;
+	serial->rx.buf_size		   = 0;
+	serial->rx.frame_buf	   = NULL;
+	serial->rx.frame_buf_size  = 0;
+	serial->rx.stamps		   = NULL;
+	serial->rx.thread		   = 0;
+	serial->tx.buf			   = NULL;
+	serial->tx.thread		   = 0;
+	serial->coalesce.is_custom = false;
+	pthread_mutex_init(&serial->open_mutex, NULL);
+	pthread_mutex_init(&serial->rx_mutex, NULL);
+	pthread_cond_init(&serial->rx_cond, NULL);
+	atomic_init(&serial->thread_stop, false);
+	atomic_init(&serial->subscribers.len, 0);
+	serial->subscribers.shared = false;
+	pthread_mutex_init(&serial->subscribers.mutex, NULL);
+	pthread_cond_init(&serial->subscribers.cond, NULL);
+	serial_capture_init(serial);
+	serial_resume_init(serial);
+	serial_signals_init(serial);
+	serial_set_coalesce_baudrate(serial, 0);
+	serial_auth_set_key(serial);
+	auth_key = serial->auth_key;
 
-	serial			  = &port_arr[port_arr_len - 1];
-	serial->auth_key  = serial_auth_make_key(port_name);
-	serial->port_name = strdup(port_name);
-	serial->port	  = NULL;
-	serial->conn	  = NULL;
-	serial->thread	  = 0;
-	serial->event_set = NULL;
-	return serial->auth_key;
+end:
+	pthread_rwlock_unlock(&port_lock);
+	return auth_key;
 }
 
 void serial_auth_revoke(const char *port_name) {
-	serial_port_t *serial = port_arr;
-	for (int i = 0; i < port_arr_len; i++, serial++) {
-		if (strcmp(port_name, serial->port_name) == 0) {
-			free(serial->auth_key);
-			serial->auth_key = NULL;
-		}
+	pthread_rwlock_wrlock(&port_lock);
+	serial_port_t *serial = serial_find_by_name(port_name);
+	if (serial != NULL && serial->auth_key != NULL) {
+		serial_unlink(&port_by_auth[serial_hash_str(serial->auth_key)], serial, offsetof(serial_port_t, auth_next));
+		free(serial->auth_key);
+		serial->auth_key = NULL;
 	}
+	pthread_rwlock_unlock(&port_lock);
 }
 
 serial_port_t *serial_get_by_auth(const char *auth_key) {
-	serial_port_t *serial = port_arr;
-	for (int i = 0; i < port_arr_len; i++, serial++) {
-		if (strcmp(auth_key, serial->auth_key) != 0)
-			continue;
-		return serial;
+	pthread_rwlock_rdlock(&port_lock);
+	serial_port_t *serial = port_by_auth[serial_hash_str(auth_key)];
+	while (serial != NULL && strcmp(auth_key, serial->auth_key) != 0) {
+		serial = serial->auth_next;
 	}
-	return NULL;
+	pthread_rwlock_unlock(&port_lock);
+	return serial;
+}
+
+serial_port_t *serial_get_by_name(const char *port_name) {
+	pthread_rwlock_rdlock(&port_lock);
+	serial_port_t *serial = serial_find_by_name(port_name);
+	pthread_rwlock_unlock(&port_lock);
+	return serial;
 }
 
 serial_port_t *serial_get_by_conn(ws_cli_conn_t *conn) {
-	serial_port_t *serial = port_arr;
-	for (int i = 0; i < port_arr_len; i++, serial++) {
-		if (serial->conn == conn)
-			return serial;
+	pthread_rwlock_rdlock(&port_lock);
+	serial_port_t *serial = port_by_conn[serial_hash_ptr(conn)];
+	while (serial != NULL && serial->conn != conn) {
+		serial = serial->conn_next;
 	}
-	return NULL;
+	pthread_rwlock_unlock(&port_lock);
+	return serial;
 }
 
-bool serial_open(serial_port_t *serial, ws_cli_conn_t *conn) {
-	if (sp_get_port_by_name(serial->port_name, &serial->port) != SP_OK)
-		return false;
+serial_port_t *serial_get_by_subscriber(ws_cli_conn_t *conn) {
+	pthread_rwlock_rdlock(&port_lock);
+	serial_subscriber_t *sub = sub_by_conn[serial_hash_ptr(conn)];
+	while (sub != NULL && sub->conn != conn) {
+		sub = sub->next;
+	}
+	// the port stays valid forever, unlike the subscriber
+	serial_port_t *serial = sub != NULL ? sub->serial : NULL;
+	pthread_rwlock_unlock(&port_lock);
+	return serial;
+}
 
-	if (sp_open(serial->port, SP_MODE_READ_WRITE) != SP_OK)
+void serial_link_subscriber(serial_subscriber_t *sub) {
+	pthread_rwlock_wrlock(&port_lock);
+	uint32_t hash	  = serial_hash_ptr(sub->conn);
+	sub->next		  = sub_by_conn[hash];
+	sub_by_conn[hash] = sub;
+	pthread_rwlock_unlock(&port_lock);
+}
+
+void serial_unlink_subscriber(serial_subscriber_t *sub) {
+	pthread_rwlock_wrlock(&port_lock);
+	serial_subscriber_t **link = &sub_by_conn[serial_hash_ptr(sub->conn)];
+	while (*link != NULL && *link != sub) {
+		link = &(*link)->next;
+	}
+	if (*link != NULL)
+		*link = sub->next;
+	sub->next = NULL;
+	pthread_rwlock_unlock(&port_lock);
+}
+
+bool serial_stats_send(const char *id) {
+	json_writer_t *writer = stdmsg_begin(id);
+	if (writer == NULL)
 		return false;
+	json_array_begin(writer, "data");
+	pthread_rwlock_rdlock(&port_lock);
+	for (int i = 0; i < port_count; i++) {
+		serial_port_t *serial = &port_chunks[i / SERIAL_CHUNK_SIZE][i % SERIAL_CHUNK_SIZE];
+		if (serial->port_name == NULL)
+			continue;
+		json_object_begin(writer, NULL);
+		serial_stats_write(writer, serial);
+		json_object_end(writer);
+	}
+	pthread_rwlock_unlock(&port_lock);
+	json_array_end(writer);
+	return stdmsg_end(writer);
+}
+
+void serial_set_coalesce(serial_port_t *serial, uint32_t threshold, uint32_t deadline_us) {
+	if (threshold == 0 || threshold > SERIAL_COALESCE_MAX)
+		threshold = SERIAL_COALESCE_MAX;
+	serial->coalesce.threshold	 = threshold;
+	serial->coalesce.deadline_us = deadline_us;
+	serial->coalesce.is_custom	 = true;
+}
+
+void serial_set_coalesce_baudrate(serial_port_t *serial, uint32_t baudrate) {
+	if (serial->coalesce.is_custom)
+		return;
+	if (baudrate < SERIAL_COALESCE_MIN_BAUD) {
+		// send everything as soon as it's read
+		serial->coalesce.threshold	 = 1;
+		serial->coalesce.deadline_us = 0;
+		return;
+	}
+	// ~10 bits per character on the wire; buffer what arrives within the deadline
+	uint64_t threshold = (uint64_t)baudrate / 10 * SERIAL_COALESCE_DEADLINE_US / 1000000;
+	if (threshold < SERIAL_COALESCE_MIN_THRESHOLD)
+		threshold = SERIAL_COALESCE_MIN_THRESHOLD;
+	if (threshold > SERIAL_COALESCE_MAX)
+		threshold = SERIAL_COALESCE_MAX;
+	serial->coalesce.threshold	 = threshold;
+	serial->coalesce.deadline_us = SERIAL_COALESCE_DEADLINE_US;
+}
+
+static bool serial_config_line_equal(const serial_config_t *a, const serial_config_t *b) {
+	return a->baudrate == b->baudrate && a->data_bits == b->data_bits && a->parity == b->parity &&
+		   a->stop_bits == b->stop_bits && a->flow_control == b->flow_control;
+}
 
+static bool serial_config_ll_equal(const serial_config_t *a, const serial_config_t *b) {
+	return a->low_latency == b->low_latency && a->rt_priority == b->rt_priority && a->rt_cpu == b->rt_cpu;
+}
+
+enum sp_return serial_set_config(serial_port_t *serial, const serial_config_t *config, uint8_t *applied) {
+	bool line_changed = !serial->config_valid || !serial_config_line_equal(config, &serial->config);
+	bool ll_changed	  = !serial_config_ll_equal(config, &serial->config);
+	if (!line_changed && !ll_changed && config->tx_buffer == serial->config.tx_buffer) {
+		// polyfills tend to reapply the same settings - nothing to do
+		*applied = serial->config_applied;
+		return SP_OK;
+	}
+
+	enum sp_return ret = SP_OK;
+	bool baudrate_ok   = true;
+	if (line_changed) {
+		// all settings in a single tcsetattr(), so that the line never passes through mixed states
+		struct sp_port_config *sp_config;
+		if ((ret = sp_new_config(&sp_config)) != SP_OK)
+			goto end;
+		sp_set_config_baudrate(sp_config, config->baudrate);
+		sp_set_config_bits(sp_config, config->data_bits);
+		sp_set_config_parity(sp_config, config->parity);
+		sp_set_config_stopbits(sp_config, config->stop_bits);
+		if (config->flow_control >= 0)
+			ret = sp_set_config_flowcontrol(sp_config, config->flow_control);
+		if (ret == SP_OK)
+			ret = sp_set_config(serial->port, sp_config);
+		if (ret != SP_OK && (config->low_latency & SERIAL_LL_EXACT_BAUD)) {
+			// a non-standard baud rate can still be set exactly, after everything else
+			baudrate_ok = false;
+			sp_set_config_baudrate(sp_config, -1);
+			ret = sp_set_config(serial->port, sp_config);
+		}
+		sp_free_config(sp_config);
+		if (ret != SP_OK)
+			goto end;
+	}
+
+	// the line settings overwrite the exact baud rate, so it has to be set again
+	if ((ll_changed || (line_changed && (config->low_latency & SERIAL_LL_EXACT_BAUD))) &&
+		serial_port_set_low_latency != NULL) {
+		serial->config_applied = serial_port_set_low_latency(
+			serial,
+			config->low_latency,
+			config->baudrate,
+			config->rt_priority,
+			config->rt_cpu
+		);
+		serial->config.low_latency = config->low_latency;
+		serial->config.rt_priority = config->rt_priority;
+		serial->config.rt_cpu	   = config->rt_cpu;
+	}
+	if (!baudrate_ok && !(serial->config_applied & SERIAL_LL_EXACT_BAUD)) {
+		ret = SP_ERR_SUPP;
+		goto end;
+	}
+
+	serial_set_coalesce_baudrate(serial, config->baudrate);
+	serial_rx_set_baudrate(serial, config->baudrate);
+	if (config->tx_buffer != 0)
+		serial_tx_set_limit(serial, config->tx_buffer);
+	else
+		serial_tx_set_baudrate(serial, config->baudrate);
+	serial->config = *config;
+
+end:
+	serial->config_valid = ret == SP_OK;
+	*applied			 = serial->config_applied;
+	return ret;
+}
+
+static void serial_rx_wake(serial_port_t *serial) {
+	if (serial_reactor_update != NULL)
+		serial_reactor_update(serial);
+	pthread_mutex_lock(&serial->rx_mutex);
+	pthread_cond_broadcast(&serial->rx_cond);
+	pthread_mutex_unlock(&serial->rx_mutex);
+}
+
+void serial_set_rx_flow(serial_port_t *serial, uint32_t window) {
+	atomic_store(&serial->rx_credits, window);
+	serial->rx_flow = window != 0;
+	serial_rx_wake(serial);
+}
+
+void serial_set_rx_credits(serial_port_t *serial, bool flow, uint32_t credits) {
+	atomic_store(&serial->rx_credits, credits);
+	serial->rx_flow = flow;
+	serial_rx_wake(serial);
+}
+
+void serial_add_rx_credits(serial_port_t *serial, uint32_t credits) {
+	atomic_fetch_add(&serial->rx_credits, credits);
+	serial_rx_wake(serial);
+}
+
+static bool serial_reader_start(serial_port_t *serial) {
 	if (sp_new_event_set(&serial->event_set) != SP_OK)
 		return false;
 	if (sp_add_port_events(serial->event_set, serial->port, SP_EVENT_RX_READY) != SP_OK)
 		return false;
+	// without it, stopping waits for sp_wait() to time out
+	if (serial_port_add_wake != NULL && !serial_port_add_wake(serial))
+		return false;
 
-	serial->conn = conn;
+	atomic_store(&serial->thread_stop, false);
+	if (!utils_thread_create(&serial->thread, websocket_serial_thread, serial)) {
+		serial->thread = 0;
+		return false;
+	}
+	return true;
+}
+
+static void serial_reader_stop(serial_port_t *serial) {
+	if (serial->thread == 0)
+		return;
+	// the reader finishes what it's doing and checks the flag, nothing is left locked or half-read
+	atomic_store(&serial->thread_stop, true);
+	pthread_mutex_lock(&serial->rx_mutex);
+	pthread_cond_broadcast(&serial->rx_cond);
+	pthread_mutex_unlock(&serial->rx_mutex);
+	if (serial->wake != NULL && serial_port_wake != NULL)
+		serial_port_wake(serial);
+	pthread_join(serial->thread, NULL);
+	serial->thread = 0;
+}
+
+static bool serial_open_port(
+	serial_port_t *serial,
+	ws_cli_conn_t *conn,
+	uint32_t rx_size,
+	uint8_t rx_flags,
+	const serial_framing_t *framing
+) {
+	if (sp_get_port_by_name(serial->port_name, &serial->port) != SP_OK) {
+		// libserialport only knows ports with a sysfs entry - try to open PTYs and such anyway
+		if (serial_port_get_virtual == NULL || !serial_port_get_virtual(serial->port_name, &serial->port))
+			return false;
+	}
 
-	if (pthread_create(&serial->thread, NULL, websocket_serial_thread, (void *)serial) != 0)
+	if (sp_open(serial->port, SP_MODE_READ_WRITE) != SP_OK)
+		return false;
+
+	// nothing is known about the port's settings yet
+	memset(&serial->config, 0, sizeof(serial->config));
+	serial->config_valid   = false;
+	serial->config_applied = 0;
+
+	serial->rx_flow	   = false;
+	serial->rx_paused  = false;
+	serial->rx_credits = 0;
+
+	if (!serial_tx_start(serial))
 		return false;
 
+	serial_set_conn(serial, conn);
+
+	if (!serial_rx_start(serial, rx_size, rx_flags, framing))
+		return false;
+	pthread_mutex_lock(&serial->subscribers.mutex);
+	serial->subscribers.shared = rx_flags & SERIAL_RX_SHARED;
+	pthread_mutex_unlock(&serial->subscribers.mutex);
+
+	// watch the port from the shared event loop, if the platform has one
+	if (serial_reactor_add != NULL) {
+		if (!serial_reactor_add(serial))
+			return false;
+	} else if (!serial_reader_start(serial)) {
+		return false;
+	}
 	return true;
 }
 
-bool serial_close(serial_port_t *serial) {
+static void serial_close_port(serial_port_t *serial) {
+	// stop reading before the port goes away
+	if (serial_reactor_remove != NULL)
+		serial_reactor_remove(serial);
+	serial_reader_stop(serial);
+	serial_signals_stop(serial);
+	serial_rx_stop(serial);
+	serial_tx_stop(serial);
+	// the subscribers only read the port, they go away with the owner
+	serial_unsubscribe_all(serial);
+	serial_resume_disable(serial);
+	// the reader thread may be shared with other ports, which keep their settings
+	if (serial_port_release_low_latency != NULL)
+		serial_port_release_low_latency(serial);
 	if (serial->event_set != NULL) {
 		sp_free_event_set(serial->event_set);
 		serial->event_set = NULL;
 	}
+	if (serial->wake != NULL && serial_port_free_wake != NULL) {
+		serial_port_free_wake(serial);
+		serial->wake = NULL;
+	}
 	if (serial->port != NULL) {
 		sp_close(serial->port);
 		sp_free_port(serial->port);
 		serial->port = NULL;
 	}
-	if (serial->thread != 0) {
-		pthread_cancel(serial->thread);
-		serial->thread = 0;
+	serial_set_conn(serial, NULL);
+	serial->rx_flow = false;
+	// forget the page's coalescing settings
+	serial->coalesce.is_custom = false;
+	serial_set_coalesce_baudrate(serial, 0);
+}
+
+enum sp_return serial_open(
+	serial_port_t *serial,
+	ws_cli_conn_t *conn,
+	uint32_t rx_size,
+	uint8_t rx_flags,
+	const serial_framing_t *framing
+) {
+	pthread_mutex_lock(&serial->open_mutex);
+	// checked under the lock, another connection may be opening or closing it right now
+	if (serial->port != NULL) {
+		pthread_mutex_unlock(&serial->open_mutex);
+		return SP_ERR_ARG;
 	}
-	serial->conn = NULL;
+	uint64_t start = utils_time_us();
+	bool ret	   = serial_open_port(serial, conn, rx_size, rx_flags, framing);
+	if (ret)
+		atomic_store_explicit(&serial->stats.open_us, utils_time_us() - start, memory_order_relaxed);
+	else
+		// whatever was opened before it failed
+		serial_close_port(serial);
+	pthread_mutex_unlock(&serial->open_mutex);
+	// a replayed capture plays from the moment the page opens its PTY
+	if (ret && serial_replay_opened != NULL)
+		serial_replay_opened(serial->port_name);
+	return ret ? SP_OK : SP_ERR_FAIL;
+}
+
+bool serial_close(serial_port_t *serial) {
+	pthread_mutex_lock(&serial->open_mutex);
+	uint64_t start = utils_time_us();
+	serial_close_port(serial);
+	atomic_store_explicit(&serial->stats.close_us, utils_time_us() - start, memory_order_relaxed);
+	pthread_mutex_unlock(&serial->open_mutex);
 	return true;
 }
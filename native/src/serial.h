@@ -2,28 +2,478 @@
 
 #pragma once
 
+// declared early, as other headers refer to it
+typedef struct serial_port serial_port_t;
+
 #include "include.h"
 
+// maximum size threshold of coalesced RX data
+#define SERIAL_COALESCE_MAX			  4096
+// default capacity of the RX ring of a single port
+#define SERIAL_RX_RING_SIZE			  (64 * 1024)
+// RX ring capacity limits, if requested by the page; always fits a full coalescing threshold
+#define SERIAL_RX_RING_MIN			  (2 * SERIAL_COALESCE_MAX)
+#define SERIAL_RX_RING_MAX			  (16 * 1024 * 1024)
+// RX options of WSM_PORT_OPEN
+#define SERIAL_RX_TIMESTAMPS		  (1 << 0) // send WSM_DATA_TS with the read time, instead of WSM_DATA
+#define SERIAL_RX_SHARED			  (1 << 1) // other connections may subscribe to the RX data (WSM_PORT_SUBSCRIBE)
+// maximum number of read-only subscribers of a shared port
+#define SERIAL_SUBSCRIBERS_MAX		  8
+// frames and bytes waiting for a subscriber; one that falls further behind is dropped, the owner never waits for it
+#define SERIAL_SUBSCRIBER_FRAMES	  64
+#define SERIAL_SUBSCRIBER_QUEUE_SIZE  (1024 * 1024)
+// room before the RX data for the longest frame header (opcode and timestamp)
+#define SERIAL_RX_HEADER_MAX		  (1 + sizeof(uint64_t))
+// number of reads whose time is remembered until their data is sent; older ones get merged
+#define SERIAL_RX_STAMPS			  256
+// RX framing modes, chosen when the port is opened
+#define SERIAL_FRAMING_NONE			  0 // coalesced byte stream
+#define SERIAL_FRAMING_DELIMITER	  1 // frames end with a delimiter (included)
+#define SERIAL_FRAMING_IDLE_GAP		  2 // frames end with a pause on the line
+#define SERIAL_FRAMING_FIXED		  3 // frames of a fixed length
+// maximum length of the framing delimiter
+#define SERIAL_FRAMING_DELIM_MAX	  4
+// default maximum size of a single frame; longer ones are cut
+#define SERIAL_FRAMING_MAX_FRAME	  4096
+// idle gap of 3.5 characters of 11 bits (as in Modbus RTU), in bits * 10
+#define SERIAL_FRAMING_GAP_BITS_X10	  385
+// fixed idle gap above 19200 baud, as the Modbus RTU spec recommends
+#define SERIAL_FRAMING_GAP_MIN_US	  1750
+// stack size of per-port threads (buffers are on the heap)
+#define SERIAL_THREAD_STACK_SIZE	  (128 * 1024)
+// no RX coalescing below this baud rate - bytes arrive too slowly to bother
+#define SERIAL_COALESCE_MIN_BAUD	  115200
+// default latency budget of coalesced RX data
+#define SERIAL_COALESCE_DEADLINE_US	  2000
+// minimum default size threshold of coalesced RX data
+#define SERIAL_COALESCE_MIN_THRESHOLD 64
+// allocated size of the TX queue of a single port
+#define SERIAL_TX_QUEUE_SIZE		  (256 * 1024)
+// TX queue limit, in milliseconds of data at the current baud rate
+#define SERIAL_TX_QUEUE_MS			  250
+// minimum TX queue limit, used at low baud rates
+#define SERIAL_TX_QUEUE_MIN			  1024
+// number of ports allocated at once; a port's address never changes
+#define SERIAL_CHUNK_SIZE			  32
+// number of buckets of each port index
+#define SERIAL_HASH_SIZE			  256
+// low-latency options of WSM_SET_CONFIG, also reported back if they took effect
+#define SERIAL_LL_ASYNC_LOW_LATENCY	  (1 << 0) // ASYNC_LOW_LATENCY of the UART driver
+#define SERIAL_LL_EXACT_BAUD		  (1 << 1) // set the exact baud rate, even if it's non-standard
+#define SERIAL_LL_RT_PRIORITY		  (1 << 2) // real-time scheduling of the reader
+#define SERIAL_LL_CPU_PIN			  (1 << 3) // pin the reader to a single CPU
+// steps of WSM_RUN_SEQUENCE, each a type followed by its arguments
+#define SERIAL_SEQ_SIGNALS			  0 // u8 DTR, u8 RTS (0 - off, 1 - on, other - leave as is)
+#define SERIAL_SEQ_BREAK			  1 // u8 state
+#define SERIAL_SEQ_DELAY			  2 // u32 microseconds, counted from the end of the previous step
+#define SERIAL_SEQ_FLUSH			  3 // u8 SERIAL_SEQ_FLUSH_* options
+#define SERIAL_SEQ_CONFIG			  4 // u32 baud rate, u8 data bits, u8 parity, u8 stop bits
+// options of SERIAL_SEQ_FLUSH
+#define SERIAL_SEQ_FLUSH_DRAIN		  (1 << 0) // write out the queued data first
+#define SERIAL_SEQ_FLUSH_RX			  (1 << 1) // discard the input buffer of the port
+#define SERIAL_SEQ_FLUSH_TX			  (1 << 2) // discard the output buffer of the port
+// maximum number of steps of a single sequence
+#define SERIAL_SEQ_STEPS_MAX		  32
+// all delays of a sequence together; a sequence holds up the page's other requests, so with its only
+// drain (up to SERIAL_TX_WAIT_MS) it has to finish before the page's request times out (5 s)
+#define SERIAL_SEQ_DELAYS_MAX_US	  (2 * 1000 * 1000)
+// delays are slept until this close to their end, then waited for actively
+#define SERIAL_SEQ_SPIN_US			  200
+// how often the input signals are checked, where the driver can't report their changes
+#define SERIAL_SIGNALS_POLL_MS		  10
+// input signals with a transition count, in the order of enum sp_signal bits: CTS, DSR, DCD, RI
+#define SERIAL_SIGNALS_COUNT		  4
+// maximum number of port filters in a single listPorts request
+#define SERIAL_FILTER_MAX			  32
+// how often the writer checks if it should stop while a write is blocked
+#define SERIAL_TX_TIMEOUT_MS		  100
+// how long the page's requests wait for the TX queue, below the page's own request timeout
+#define SERIAL_TX_WAIT_MS			  2000
+// buckets of the read size histogram: empty reads, then one per power of two (the last one takes the rest)
+#define SERIAL_STATS_READ_BUCKETS	  14
+// error counters, one per request opcode (responses start at WSM_ERROR)
+#define SERIAL_STATS_OPCODES		  128
+
+// number of records that can wait for the capture writer
+#define SERIAL_CAPTURE_SLOTS	 1024
+// maximum size of a capture record with its header; longer data is split into more records
+#define SERIAL_CAPTURE_SLOT_SIZE 4096
+// how often the capture writer writes the queued records to the file
+#define SERIAL_CAPTURE_FLUSH_US	 10000
+// start of every capture file, followed by the records
+#define SERIAL_CAPTURE_MAGIC	 "WSERCAP1"
+// capture record types
+#define SERIAL_CAPTURE_START	 0 // capture started, with the port name
+#define SERIAL_CAPTURE_OPEN		 1 // port opened by the page
+#define SERIAL_CAPTURE_CLOSE	 2 // port closed by the page
+#define SERIAL_CAPTURE_RX		 3 // data read from the port
+#define SERIAL_CAPTURE_TX		 4 // data sent by the page
+#define SERIAL_CAPTURE_CONFIG	 5 // WSM_SET_CONFIG payload, once applied
+#define SERIAL_CAPTURE_SIGNALS	 6 // DTR and RTS, once set
+#define SERIAL_CAPTURE_BREAK	 7 // break state, once set
+// longest time that a port may wait to be resumed, once the page's connection is gone
+#define SERIAL_RESUME_MAX_MS	 60000
+// how long the replay sleeps at once, so that it notices being stopped
+#define SERIAL_REPLAY_POLL_MS	 100
+
+// cheap enough for the hot path; the counters are only read for reporting
+#define SERIAL_STATS_ADD(serial, field, value) \
+	atomic_fetch_add_explicit(&(serial)->stats.field, value, memory_order_relaxed)
+// a single relaxed load when not capturing
+#define SERIAL_CAPTURE_ADD(serial, type, data, len, time_us)                       \
+	do {                                                                           \
+		if (atomic_load_explicit(&(serial)->capture.active, memory_order_relaxed)) \
+			serial_capture_add(serial, type, data, len, time_us);                  \
+	} while (0)
+
+typedef struct {
+	int transport; // enum sp_transport, -1 - any
+	int vid;	   // USB vendor ID, -1 - any
+	int pid;	   // USB product ID, -1 - any
+	char *serial;  // USB serial number, NULL - any
+	char *name;	   // glob pattern of the port name, NULL - any
+} serial_filter_t;
+
+// what a port's JSON is made of, from libserialport or read by the platform directly
+typedef struct {
+	const char *name;
+	enum sp_transport transport;
+	const char *description;	   // as the platform describes it, NULL - unknown
+	int usb_bus;				   // -1 - unknown
+	int usb_address;			   // -1 - unknown
+	int usb_vid;				   // -1 - unknown
+	int usb_pid;				   // -1 - unknown
+	const char *usb_manufacturer;  // NULL - unknown
+	const char *usb_product;	   // NULL - unknown
+	const char *usb_serial;		   // NULL - unknown
+	const char *bluetooth_address; // NULL - unknown
+} serial_port_details_t;
+
+typedef struct {
+	uint32_t threshold;	  // send RX data once this many bytes are buffered
+	uint32_t deadline_us; // send RX data once the oldest byte is this old (0 - immediately)
+	bool is_custom;		  // set by the page; don't recalculate on baud rate changes
+} serial_coalesce_t;
+
+typedef struct {
+	uint32_t baudrate;
+	uint8_t data_bits;
+	uint8_t parity; // enum sp_parity
+	uint8_t stop_bits;
+	int8_t flow_control; // enum sp_flowcontrol, -1 - leave as is
+	uint32_t tx_buffer;	 // TX queue limit in bytes, 0 - depending on the baud rate
+	uint8_t low_latency; // SERIAL_LL_* options
+	uint8_t rt_priority; // SCHED_FIFO priority, with SERIAL_LL_RT_PRIORITY
+	int8_t rt_cpu;		 // CPU number, with SERIAL_LL_CPU_PIN
+} serial_config_t;
+
+typedef struct {
+	uint8_t *buf;		   // ring buffer of SERIAL_TX_QUEUE_SIZE bytes
+	uint32_t head;		   // where the next enqueued byte goes
+	uint32_t len;		   // number of bytes waiting to be written (including the one being written)
+	uint32_t limit;		   // how many bytes the page may have queued, depending on the baud rate or set by the page
+	char *error;		   // error message of a failed or timed out write, reported in the next response
+	bool stop;			   // the writer thread should finish
+	pthread_t thread;	   // writer thread
+	pthread_mutex_t mutex; // protects the fields above
+	pthread_cond_t cond;   // signalled when data is enqueued or written
+} serial_tx_t;
+
+typedef struct {
+	uint8_t mode;								 // SERIAL_FRAMING_*
+	uint8_t delimiter_len;						 // with SERIAL_FRAMING_DELIMITER
+	uint8_t delimiter[SERIAL_FRAMING_DELIM_MAX]; // with SERIAL_FRAMING_DELIMITER
+	uint32_t max_frame;							 // longer frames are cut, 0 - default
+	uint32_t record_len;						 // with SERIAL_FRAMING_FIXED
+	uint32_t gap_us;							 // with SERIAL_FRAMING_IDLE_GAP, 0 - depending on the baud rate
+} serial_framing_t;
+
+typedef struct {
+	uint64_t end;	  // RX byte count after the read
+	uint64_t time_us; // when the read was done
+} serial_rx_stamp_t;
+
+typedef struct {
+	uint8_t *buf;	   // header slot, followed by the ring; the reader never writes the header bytes before the tail
+	uint32_t buf_size; // allocated size of the ring, kept if big enough, 0 once serial_rx_stop() frees it
+	uint32_t size;	   // capacity of the ring, as requested by the page
+	uint32_t head;	   // where the next read byte goes
+	uint32_t len;	   // number of buffered bytes, at most size - header
+	uint8_t flags;	   // SERIAL_RX_* options
+	uint8_t header;	   // size of the frame header, kept free before the tail
+	uint64_t deadline; // when to send the buffered data
+	bool stop;		   // the sender thread should finish
+	bool held;		   // a resumed port keeps the buffered data until the page is ready to read it
+	pthread_t thread;  // sender thread
+	serial_framing_t framing;
+	uint8_t *frame_buf;		   // header slot and a single frame, for frames that wrap around the ring
+	uint32_t frame_buf_size;   // allocated size of the frame buffer, 0 once serial_rx_stop() frees it
+	uint32_t scanned;		   // bytes after the tail already searched for the delimiter
+	uint32_t gap_us;		   // idle gap that ends a frame
+	uint64_t last_us;		   // when the last data was buffered
+	serial_rx_stamp_t *stamps; // read times of the buffered data, with SERIAL_RX_TIMESTAMPS
+	uint32_t stamps_head;	   // where the next read time goes
+	uint32_t stamps_len;	   // number of remembered read times
+	uint64_t in;			   // bytes buffered since the port was opened
+	uint64_t out;			   // bytes sent since the port was opened
+} serial_rx_t;
+
+// header of every record in a capture file
+typedef struct __attribute__((packed)) {
+	uint8_t type;	  // SERIAL_CAPTURE_*
+	uint32_t len;	  // length of the data following the header
+	uint64_t time_us; // since the capture was started
+} serial_capture_record_t;
+
+typedef struct {
+	ring_t ring;			  // records waiting for the writer, added by any thread
+	FILE *file;				  // capture file, written by the writer thread only
+	uint64_t start_us;		  // when the capture was started
+	_Atomic bool active;	  // records are being added
+	_Atomic uint32_t adding;  // threads adding a record right now
+	_Atomic uint64_t dropped; // records that didn't fit in the ring
+	bool stop;				  // the writer thread should finish, once the ring is empty
+	pthread_t thread;		  // writer thread
+	pthread_mutex_t mutex;	  // protects the fields above, used to wait for the next flush
+	pthread_cond_t cond;	  // signalled to stop the writer
+} serial_capture_t;
+
+typedef struct {
+	uint8_t mask;		   // enum sp_signal bits that the page watches, 0 - none
+	bool stop;			   // the watcher thread should finish
+	_Atomic bool running;  // the watcher thread didn't finish yet
+	pthread_t thread;	   // watcher thread
+	pthread_mutex_t mutex; // protects the stop flag, used to wait between polls
+	pthread_cond_t cond;   // signalled to stop the watcher
+} serial_signals_t;
+
 typedef struct {
+	char *token;		   // given to the page on open, to resume the session; NULL - close with the connection
+	uint32_t grace_ms;	   // how long the port stays open without a connection
+	bool detached;		   // the connection is gone, the port is waiting to be resumed
+	uint32_t session;	   // bumped on every detach, so that a late timer can't close a resumed port
+	bool rx_flow;		   // RX flow control of the page that left
+	uint32_t rx_credits;   // RX credits the page left with
+	uint64_t rx_bytes;	   // bytes read from the port when the page left
+	pthread_mutex_t mutex; // protects the fields above
+	pthread_cond_t cond;   // signalled when the port is resumed
+} serial_resume_t;
+
+typedef struct {
+	_Atomic uint32_t refs; // subscribers that didn't send it yet, and the RX sender
+	uint32_t len;
+	uint8_t data[];
+} serial_subscriber_frame_t;
+
+typedef struct serial_subscriber {
+	serial_port_t *serial;
+	ws_cli_conn_t *conn;
+	// waiting to be sent, oldest first
+	serial_subscriber_frame_t *frames[SERIAL_SUBSCRIBER_FRAMES];
+	uint32_t head;		   // next free slot of the frames
+	uint32_t len;		   // frames waiting to be sent
+	uint32_t queued;	   // bytes waiting to be sent
+	bool sending;		   // the sender thread is in ws_sendframe_bin()
+	bool failed;		   // a send failed, the connection is going away
+	bool stop;			   // the sender thread should finish
+	bool close;			   // the sender thread should close the connection when it finishes
+	pthread_mutex_t mutex; // protects the fields above
+	pthread_cond_t cond;   // signalled when a frame is queued, or a send finishes
+	// next subscriber in the same bucket of the subscriber index
+	struct serial_subscriber *next;
+} serial_subscriber_t;
+
+typedef struct {
+	serial_subscriber_t *subs[SERIAL_SUBSCRIBERS_MAX]; // read-only connections of a shared port
+	_Atomic uint8_t len;							   // checked without the lock on every frame
+	bool shared;									   // the port is open with SERIAL_RX_SHARED
+	pthread_mutex_t mutex;							   // protects the fields above, never held while sending
+	pthread_cond_t cond;							   // signalled when a dropped subscriber lets go of its connection
+} serial_subscribers_t;
+
+typedef struct {
+	_Atomic uint64_t rx_bytes;								// read from the port
+	_Atomic uint64_t rx_frames;								// WSM_DATA frames sent to the page
+	_Atomic uint64_t rx_frames_cut;							// frames cut at the maximum frame size
+	_Atomic uint64_t subscribers_dropped;					// subscribers dropped for being too slow
+	_Atomic uint64_t tx_bytes;								// written to the port
+	_Atomic uint64_t tx_frames;								// WSM_DATA frames received from the page
+	_Atomic uint64_t read_sizes[SERIAL_STATS_READ_BUCKETS]; // sp_nonblocking_read() calls, by result size
+	_Atomic uint64_t wait_wakeups;							// sp_wait() or the reactor woke up with data
+	_Atomic uint64_t wait_timeouts;							// sp_wait() woke up without data
+	_Atomic uint64_t write_blocked_us;						// time spent in sp_blocking_write()
+	_Atomic uint64_t drain_blocked_us;						// time spent in sp_drain()
+	_Atomic uint64_t open_us;								// time the last serial_open() took
+	_Atomic uint64_t close_us;								// time the last serial_close() took
+	_Atomic uint32_t rx_ring_high;							// most bytes ever buffered in the RX ring
+	_Atomic uint32_t errors[SERIAL_STATS_OPCODES];			// error responses, by request opcode
+} serial_stats_t;
+
+struct serial_port {
 	char *auth_key;
 	char *port_name;
 	struct sp_port *port;
 	ws_cli_conn_t *conn;
+	pthread_mutex_t open_mutex; // serializes opening and closing, which different connections may do at once
 	pthread_t thread;
 	struct sp_event_set *event_set;
-} serial_port_t;
+	_Atomic bool thread_stop; // the reader thread should finish
+	void *wake;				  // handle in the event set that interrupts sp_wait() of the reader
+	serial_coalesce_t coalesce;
+	serial_config_t config;	 // shadow of the applied settings, to skip reapplying them
+	bool config_valid;		 // the shadow matches the port; cleared on open and on errors
+	uint8_t config_applied;	 // SERIAL_LL_* options that took effect
+	uint8_t reader_priority; // SCHED_FIFO priority this port holds on the shared reader thread, 0 - none
+	int8_t reader_cpu;		 // CPU this port holds the shared reader thread pinned to, -1 - none
+	serial_rx_t rx;
+	bool rx_flow;				 // RX flow control enabled, only read what the page can take
+	bool rx_paused;				 // out of credits, the port is not being read (reactor only)
+	_Atomic uint32_t rx_credits; // bytes that can still be read with flow control enabled
+	pthread_mutex_t rx_mutex;	 // protects the RX ring, used to wait for data, space and credits
+	pthread_cond_t rx_cond;		 // signalled when credits are granted, or the RX ring changes
+	serial_tx_t tx;
+	serial_subscribers_t subscribers;
+	serial_resume_t resume;
+	serial_signals_t signals;
+	serial_stats_t stats;	  // kept for as long as the port is known, across reopening
+	serial_capture_t capture; // kept for as long as the port is known, like the stats
+	serial_port_t *auth_next; // next port in the same bucket of the auth key index
+	serial_port_t *conn_next; // next port in the same bucket of the connection index
+	serial_port_t *name_next; // next port in the same bucket of the port name index
+};
+
+const char *serial_transport_to_str(enum sp_transport transport);
+int serial_transport_from_str(const char *transport);
 
-cJSON *serial_list_ports_json();
+bool serial_filter_parse(cJSON *json, serial_filter_t **filters, int *filters_len);
+void serial_filter_free(serial_filter_t *filters, int filters_len);
+uint32_t serial_filter_name(const serial_filter_t *filters, int filters_len, uint32_t mask, const char *name);
+uint32_t serial_filter_transport(
+	const serial_filter_t *filters,
+	int filters_len,
+	uint32_t mask,
+	enum sp_transport transport
+);
+uint32_t serial_filter_usb_id(const serial_filter_t *filters, int filters_len, uint32_t mask, int vid, int pid);
+uint32_t serial_filter_serial(const serial_filter_t *filters, int filters_len, uint32_t mask, const char *serial);
+bool serial_filter_match_json(const serial_filter_t *filters, int filters_len, cJSON *item);
 
+void serial_port_get_details(struct sp_port *port, serial_port_details_t *details);
+cJSON *serial_port_details_to_json(const serial_port_details_t *details, const char *id, const char *description);
+cJSON *serial_port_to_json(struct sp_port *port);
+cJSON *serial_list_ports_json(const serial_filter_t *filters, int filters_len);
+__attribute__((weak)) cJSON *serial_list_ports_platform(const serial_filter_t *filters, int filters_len);
+bool serial_list_ports_send(const char *id, const serial_filter_t *filters, int filters_len);
+void serial_ports_changed();
+void serial_ports_unwatched();
+__attribute__((weak)) bool serial_hotplug_start();
+#ifdef __linux__
+extern const char *serial_linux_sysfs_tty;
+bool serial_linux_set_exact_baud(int fd, uint32_t baudrate);
+#endif
+
+char *serial_auth_make_key(const char *port_name);
 const char *serial_auth_grant(const char *port_name);
 void serial_auth_revoke(const char *port_name);
 
 char *serial_port_get_id(struct sp_port *port);
 __attribute__((weak)) char *serial_port_get_description(struct sp_port *port);
 __attribute__((weak)) void serial_port_fix_details(struct sp_port *port, const char *id);
+__attribute__((weak)) bool serial_port_get_virtual(const char *port_name, struct sp_port **port);
+__attribute__((weak)) uint8_t
+serial_port_set_low_latency(serial_port_t *serial, uint8_t options, uint32_t baudrate, uint8_t priority, int8_t cpu);
+__attribute__((weak)) void serial_port_release_low_latency(serial_port_t *serial);
+
+__attribute__((weak)) bool serial_port_get_signal_counts(serial_port_t *serial, uint32_t *counts);
+__attribute__((weak)) bool serial_port_wait_signals(serial_port_t *serial, uint8_t mask);
+__attribute__((weak)) void serial_port_wake_signals(pthread_t thread);
+__attribute__((weak)) bool serial_port_add_wake(serial_port_t *serial);
+__attribute__((weak)) void serial_port_wake(serial_port_t *serial);
+__attribute__((weak)) void serial_port_free_wake(serial_port_t *serial);
+
+__attribute__((weak)) bool serial_reactor_add(serial_port_t *serial);
+__attribute__((weak)) void serial_reactor_remove(serial_port_t *serial);
+__attribute__((weak)) void serial_reactor_update(serial_port_t *serial);
+__attribute__((weak)) pthread_t serial_reactor_get_thread();
 
 serial_port_t *serial_get_by_auth(const char *auth_key);
 serial_port_t *serial_get_by_conn(ws_cli_conn_t *conn);
+serial_port_t *serial_get_by_name(const char *port_name);
+serial_port_t *serial_get_by_subscriber(ws_cli_conn_t *conn);
+void serial_set_conn(serial_port_t *serial, ws_cli_conn_t *conn);
+
+void serial_link_subscriber(serial_subscriber_t *sub);
+void serial_unlink_subscriber(serial_subscriber_t *sub);
+
+bool serial_subscribe(serial_port_t *serial, ws_cli_conn_t *conn);
+serial_port_t *serial_unsubscribe(ws_cli_conn_t *conn);
+void serial_unsubscribe_all(serial_port_t *serial);
+void serial_subscribers_send(serial_port_t *serial, const uint8_t *frame, uint32_t len);
+
+void serial_set_coalesce(serial_port_t *serial, uint32_t threshold, uint32_t deadline_us);
+void serial_set_coalesce_baudrate(serial_port_t *serial, uint32_t baudrate);
+enum sp_return serial_set_config(serial_port_t *serial, const serial_config_t *config, uint8_t *applied);
+
+void serial_set_rx_flow(serial_port_t *serial, uint32_t window);
+void serial_set_rx_credits(serial_port_t *serial, bool flow, uint32_t credits);
+void serial_add_rx_credits(serial_port_t *serial, uint32_t credits);
+
+bool serial_rx_start(serial_port_t *serial, uint32_t size, uint8_t flags, const serial_framing_t *framing);
+void serial_rx_set_baudrate(serial_port_t *serial, uint32_t baudrate);
+void serial_rx_stop(serial_port_t *serial);
+uint32_t serial_rx_reserve(serial_port_t *serial, uint8_t **data);
+void serial_rx_commit(serial_port_t *serial, uint32_t len, uint64_t time_us);
+bool serial_rx_has_space(serial_port_t *serial);
+void serial_rx_hold(serial_port_t *serial, bool held);
+
+bool serial_tx_start(serial_port_t *serial);
+void serial_tx_stop(serial_port_t *serial);
+void serial_tx_set_baudrate(serial_port_t *serial, uint32_t baudrate);
+void serial_tx_set_limit(serial_port_t *serial, uint32_t limit);
+bool serial_tx_enqueue(serial_port_t *serial, const uint8_t *data, uint32_t len);
+bool serial_tx_flush(serial_port_t *serial);
+char *serial_tx_get_error(serial_port_t *serial);
+uint32_t serial_tx_get_credits(serial_port_t *serial);
+
+void serial_stats_read(serial_port_t *serial, int len);
+void serial_stats_error(serial_port_t *serial, uint8_t opcode);
+void serial_stats_write(json_writer_t *writer, serial_port_t *serial);
+bool serial_stats_send(const char *id);
+
+void serial_capture_init(serial_port_t *serial);
+bool serial_capture_start(serial_port_t *serial, const char *path);
+bool serial_capture_stop(serial_port_t *serial);
+void serial_capture_add(serial_port_t *serial, uint8_t type, const void *data, uint32_t len, uint64_t time_us);
+
+void serial_resume_init(serial_port_t *serial);
+bool serial_resume_enable(serial_port_t *serial, uint32_t grace_ms);
+void serial_resume_disable(serial_port_t *serial);
+bool serial_resume_detach(serial_port_t *serial);
+bool serial_resume_attach(serial_port_t *serial, ws_cli_conn_t *conn, const char *token);
+bool serial_resume_cancel(serial_port_t *serial);
+
+void serial_signals_init(serial_port_t *serial);
+bool serial_signals_watch(serial_port_t *serial, uint8_t mask);
+void serial_signals_stop(serial_port_t *serial);
+
+enum sp_return serial_sequence_run(
+	serial_port_t *serial,
+	const uint8_t *steps,
+	uint32_t len,
+	uint32_t *timings,
+	uint8_t *count
+);
+
+__attribute__((weak)) const char *serial_replay_start(const char *path, double speed);
+__attribute__((weak)) bool serial_replay_stop(const char *port_name);
+__attribute__((weak)) void serial_replay_opened(const char *port_name);
 
-bool serial_open(serial_port_t *serial, ws_cli_conn_t *conn);
+// SP_ERR_ARG - the port is open already
+enum sp_return serial_open(
+	serial_port_t *serial,
+	ws_cli_conn_t *conn,
+	uint32_t rx_size,
+	uint8_t rx_flags,
+	const serial_framing_t *framing
+);
 bool serial_close(serial_port_t *serial);
@@ -0,0 +1,137 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+// serializes starting and stopping, which stdmsg workers may do at once
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool serial_capture_write(serial_capture_t *capture) {
+	bool wrote = false;
+	uint32_t len;
+	const void *data;
+	while ((data = ring_peek(&capture->ring, &len)) != NULL) {
+		fwrite(data, sizeof(char), len, capture->file);
+		ring_pop(&capture->ring);
+		wrote = true;
+	}
+	return wrote;
+}
+
+static void *serial_capture_thread(void *arg) {
+	serial_capture_t *capture = arg;
+
+	pthread_mutex_lock(&capture->mutex);
+	while (1) {
+		// nothing can be added once it's inactive and nobody is in the middle of adding
+		bool done = capture->stop && atomic_load(&capture->adding) == 0;
+		pthread_mutex_unlock(&capture->mutex);
+		// the producers never wait for the file - it's written in batches
+		if (serial_capture_write(capture))
+			fflush(capture->file);
+		pthread_mutex_lock(&capture->mutex);
+		if (done)
+			break;
+		if (!capture->stop)
+			utils_cond_wait_us(&capture->cond, &capture->mutex, SERIAL_CAPTURE_FLUSH_US);
+	}
+	pthread_mutex_unlock(&capture->mutex);
+	return NULL;
+}
+
+void serial_capture_init(serial_port_t *serial) {
+	serial_capture_t *capture = &serial->capture;
+	capture->ring.slots		  = NULL;
+	capture->file			  = NULL;
+	capture->thread			  = 0;
+	atomic_init(&capture->active, false);
+	atomic_init(&capture->adding, 0);
+	atomic_init(&capture->dropped, 0);
+	pthread_mutex_init(&capture->mutex, NULL);
+	pthread_cond_init(&capture->cond, NULL);
+}
+
+bool serial_capture_start(serial_port_t *serial, const char *path) {
+	serial_capture_t *capture = &serial->capture;
+	bool ret				  = false;
+	pthread_mutex_lock(&capture_lock);
+	if (capture->thread != 0)
+		goto end;
+	// kept until the port is forgotten, a late producer may still look at it
+	if (capture->ring.slots == NULL && !ring_init(&capture->ring, SERIAL_CAPTURE_SLOTS, SERIAL_CAPTURE_SLOT_SIZE))
+		goto end;
+	if ((capture->file = fopen(path, "wb")) == NULL)
+		goto end;
+	fwrite(SERIAL_CAPTURE_MAGIC, sizeof(char), sizeof(SERIAL_CAPTURE_MAGIC) - 1, capture->file);
+	capture->start_us = utils_time_us();
+	capture->stop	  = false;
+	atomic_store(&capture->dropped, 0);
+	if (!utils_thread_create(&capture->thread, serial_capture_thread, capture)) {
+		capture->thread = 0;
+		fclose(capture->file);
+		capture->file = NULL;
+		goto end;
+	}
+	atomic_store(&capture->active, true);
+	serial_capture_add(serial, SERIAL_CAPTURE_START, serial->port_name, strlen(serial->port_name), capture->start_us);
+	ret = true;
+end:
+	pthread_mutex_unlock(&capture_lock);
+	return ret;
+}
+
+bool serial_capture_stop(serial_port_t *serial) {
+	serial_capture_t *capture = &serial->capture;
+	pthread_mutex_lock(&capture_lock);
+	pthread_t thread = capture->thread;
+	if (thread != 0) {
+		atomic_store(&capture->active, false);
+		pthread_mutex_lock(&capture->mutex);
+		capture->stop = true;
+		pthread_cond_broadcast(&capture->cond);
+		pthread_mutex_unlock(&capture->mutex);
+		// writes out everything that was added
+		pthread_join(thread, NULL);
+		capture->thread = 0;
+		fclose(capture->file);
+		capture->file = NULL;
+		if (atomic_load(&capture->dropped) != 0)
+			stdmsg_send_log(
+				"Capture of %s dropped %llu records",
+				serial->port_name,
+				(unsigned long long)atomic_load(&capture->dropped)
+			);
+	}
+	pthread_mutex_unlock(&capture_lock);
+	return thread != 0;
+}
+
+void serial_capture_add(serial_port_t *serial, uint8_t type, const void *data, uint32_t len, uint64_t time_us) {
+	serial_capture_t *capture = &serial->capture;
+	atomic_fetch_add(&capture->adding, 1);
+	// checked again, the writer only finishes once nobody is adding
+	if (!atomic_load(&capture->active))
+		goto end;
+	serial_capture_record_t record = {
+		.type	 = type,
+		.time_us = time_us > capture->start_us ? time_us - capture->start_us : 0,
+	};
+	uint32_t max = SERIAL_CAPTURE_SLOT_SIZE - sizeof(record);
+	do {
+		// long data is split into more records of the same time
+		record.len = len > max ? max : len;
+		uint32_t pos;
+		uint8_t *slot = ring_reserve(&capture->ring, &pos);
+		if (slot == NULL) {
+			// never wait for the disk on the data path
+			atomic_fetch_add_explicit(&capture->dropped, 1, memory_order_relaxed);
+			goto end;
+		}
+		memcpy(slot, &record, sizeof(record));
+		memcpy(slot + sizeof(record), data, record.len);
+		ring_commit(&capture->ring, pos, sizeof(record) + record.len);
+		data = (const uint8_t *)data + record.len;
+		len -= record.len;
+	} while (len != 0);
+end:
+	atomic_fetch_sub(&capture->adding, 1);
+}
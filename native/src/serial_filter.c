@@ -0,0 +1,131 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+#include <fnmatch.h>
+
+static int serial_filter_parse_int(cJSON *item, const char *key) {
+	cJSON *value = cJSON_GetObjectItem(item, key);
+	if (!cJSON_IsNumber(value))
+		return -1;
+	return value->valueint;
+}
+
+static char *serial_filter_parse_str(cJSON *item, const char *key) {
+	const char *value = cJSON_GetStringValue(cJSON_GetObjectItem(item, key));
+	if (value == NULL)
+		return NULL;
+	return strdup(value);
+}
+
+bool serial_filter_parse(cJSON *json, serial_filter_t **filters, int *filters_len) {
+	*filters	 = NULL;
+	*filters_len = 0;
+	if (json == NULL || cJSON_IsNull(json))
+		return true;
+	if (!cJSON_IsArray(json))
+		return false;
+
+	int len = cJSON_GetArraySize(json);
+	if (len == 0)
+		return true;
+	if (len > SERIAL_FILTER_MAX)
+		return false;
+	serial_filter_t *items = calloc(len, sizeof(*items));
+	if (items == NULL)
+		return false;
+
+	int i = 0;
+	cJSON *item;
+	cJSON_ArrayForEach(item, json) {
+		serial_filter_t *filter = &items[i++];
+		const char *transport	= cJSON_GetStringValue(cJSON_GetObjectItem(item, "transport"));
+		filter->transport		= serial_transport_from_str(transport);
+		filter->vid				= serial_filter_parse_int(item, "usbVendorId");
+		filter->pid				= serial_filter_parse_int(item, "usbProductId");
+		filter->serial			= serial_filter_parse_str(item, "serialNumber");
+		filter->name			= serial_filter_parse_str(item, "name");
+	}
+
+	*filters	 = items;
+	*filters_len = len;
+	return true;
+}
+
+void serial_filter_free(serial_filter_t *filters, int filters_len) {
+	for (int i = 0; i < filters_len; i++) {
+		free(filters[i].serial);
+		free(filters[i].name);
+	}
+	free(filters);
+}
+
+uint32_t serial_filter_name(const serial_filter_t *filters, int filters_len, uint32_t mask, const char *name) {
+	for (int i = 0; i < filters_len; i++) {
+		const char *glob = filters[i].name;
+		if (glob != NULL && fnmatch(glob, name, 0) != 0)
+			mask &= ~(1u << i);
+	}
+	return mask;
+}
+
+uint32_t serial_filter_transport(
+	const serial_filter_t *filters,
+	int filters_len,
+	uint32_t mask,
+	enum sp_transport transport
+) {
+	for (int i = 0; i < filters_len; i++) {
+		const serial_filter_t *filter = &filters[i];
+		// USB-specific filters can't match other ports
+		bool is_usb = filter->vid != -1 || filter->pid != -1 || filter->serial != NULL;
+		if (filter->transport != -1 && filter->transport != transport)
+			mask &= ~(1u << i);
+		if (is_usb && transport != SP_TRANSPORT_USB)
+			mask &= ~(1u << i);
+	}
+	return mask;
+}
+
+uint32_t serial_filter_usb_id(const serial_filter_t *filters, int filters_len, uint32_t mask, int vid, int pid) {
+	for (int i = 0; i < filters_len; i++) {
+		const serial_filter_t *filter = &filters[i];
+		if ((filter->vid != -1 && filter->vid != vid) || (filter->pid != -1 && filter->pid != pid))
+			mask &= ~(1u << i);
+	}
+	return mask;
+}
+
+uint32_t serial_filter_serial(const serial_filter_t *filters, int filters_len, uint32_t mask, const char *serial) {
+	for (int i = 0; i < filters_len; i++) {
+		const serial_filter_t *filter = &filters[i];
+		if (filter->serial != NULL && (serial == NULL || strcmp(filter->serial, serial) != 0))
+			mask &= ~(1u << i);
+	}
+	return mask;
+}
+
+bool serial_filter_match_json(const serial_filter_t *filters, int filters_len, cJSON *item) {
+	if (filters_len == 0)
+		return true;
+	// each bit is a filter that can still match the port
+	uint32_t mask = UINT32_MAX;
+
+	const char *name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "name"));
+	if (name != NULL)
+		mask = serial_filter_name(filters, filters_len, mask, name);
+
+	int transport = serial_transport_from_str(cJSON_GetStringValue(cJSON_GetObjectItem(item, "transport")));
+	if (transport != -1)
+		mask = serial_filter_transport(filters, filters_len, mask, transport);
+
+	cJSON *usb = cJSON_GetObjectItem(item, "usb");
+	if (usb != NULL) {
+		int vid			   = serial_filter_parse_int(usb, "vid");
+		int pid			   = serial_filter_parse_int(usb, "pid");
+		const char *serial = cJSON_GetStringValue(cJSON_GetObjectItem(usb, "serial"));
+		mask			   = serial_filter_usb_id(filters, filters_len, mask, vid, pid);
+		mask			   = serial_filter_serial(filters, filters_len, mask, serial);
+	}
+	return mask != 0;
+}
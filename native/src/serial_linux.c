@@ -2,77 +2,92 @@
 
 #ifdef __linux__
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // pthread_setaffinity_np()
+#endif
+
 #define LIBSERIALPORT_ATBUILD
 #include "libserialport_internal.h"
 #undef DEBUG
 
 #include "serial.h"
 
-char *serial_port_get_id(struct sp_port *port) {
-	const char *name			= sp_get_port_name(port);
-	enum sp_transport transport = sp_get_port_transport(port);
-
-	int id_length = strlen(name);
-
-	switch (transport) {
-		case SP_TRANSPORT_USB: {
-			int vid = 0, pid = 0;
-			const char *serial = sp_get_port_usb_serial(port);
-			if (sp_get_port_usb_vid_pid(port, &vid, &pid) == SP_OK)
-				id_length += sizeof("#VID=xxxx#PID=xxxx") - 1;
-			if (serial != NULL)
-				id_length += sizeof("#SN=") - 1 + strlen(serial);
-
-			char *id = malloc(id_length + 1);
-			if (id == NULL)
-				return NULL;
-
-			if (vid != 0 && pid != 0) {
-				if (serial != NULL)
-					sprintf(id, "%s#VID=%04X#PID=%04X#SN=%s", name, vid, pid, serial);
-				else
-					sprintf(id, "%s#VID=%04X#PID=%04X", name, vid, pid);
-			} else {
-				if (serial != NULL)
-					sprintf(id, "%s#SN=%s", name, serial);
-				else
-					strcpy(id, name);
-			}
-
-			return id;
-		}
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/serial.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 
-		case SP_TRANSPORT_BLUETOOTH: {
-			const char *address = sp_get_port_bluetooth_address(port);
-			if (address != NULL)
-				id_length += sizeof("#ADDR=") - 1 + strlen(address);
+// interrupts TIOCMIWAIT of a signal watcher that should stop
+#define SERIAL_WAKE_SIGNAL SIGUSR2
 
-			char *id = malloc(id_length + 1);
-			if (id == NULL)
-				return NULL;
+// highest SCHED_FIFO priority
+#define SERIAL_RT_PRIORITY_MAX 99
 
-			if (address != NULL)
-				sprintf(id, "%s#ADDR=%s", name, address);
-			else
-				strcpy(id, name);
+// can be pointed at a synthetic tree, e.g. by the enumeration benchmark
+const char *serial_linux_sysfs_tty = "/sys/class/tty";
 
-			return id;
-		}
+// ports listed from sysfs and ports found by libserialport get the same ID and description, so that they can be matched
+static char *serial_linux_id(const serial_port_details_t *details) {
+	char usb_id[sizeof("#VID=xxxxxxxx#PID=xxxxxxxx")] = "";
+	const char *usb_serial							  = NULL;
+	const char *address								  = NULL;
+	switch (details->transport) {
+		case SP_TRANSPORT_USB:
+			if (details->usb_vid >= 0 && details->usb_pid >= 0)
+				snprintf(usb_id, sizeof(usb_id), "#VID=%04X#PID=%04X", details->usb_vid, details->usb_pid);
+			usb_serial = details->usb_serial;
+			break;
+
+		case SP_TRANSPORT_BLUETOOTH:
+			address = details->bluetooth_address;
+			break;
 
 		case SP_TRANSPORT_NATIVE:
-		default: {
-			return strdup(port->name);
-		}
+		default:
+			break;
 	}
-}
 
-char *serial_port_get_description(struct sp_port *port) {
-	const char *name		= sp_get_port_name(port);
-	const char *description = sp_get_port_description(port);
+	char *id;
+	if (asprintf(
+			&id,
+			"%s%s%s%s%s%s",
+			details->name,
+			usb_id,
+			usb_serial != NULL ? "#SN=" : "",
+			usb_serial != NULL ? usb_serial : "",
+			address != NULL ? "#ADDR=" : "",
+			address != NULL ? address : ""
+		) < 0)
+		return NULL;
+	return id;
+}
 
+static char *serial_linux_description(const serial_port_details_t *details) {
+	const char *name = details->name;
 	if (strstr(name, "/dev/") == name)
 		name += sizeof("/dev/") - 1;
 
+	const char *description = name;
+	switch (details->transport) {
+		case SP_TRANSPORT_USB:
+			description = details->usb_product != NULL ? details->usb_product : "USB";
+			break;
+
+		case SP_TRANSPORT_BLUETOOTH:
+			if (details->description != NULL)
+				description = details->description;
+			break;
+
+		case SP_TRANSPORT_NATIVE:
+		default:
+			break;
+	}
+
 	char *full_description = malloc(strlen(name) + sizeof(" - ") + strlen(description));
 	if (full_description == NULL)
 		return NULL;
@@ -86,4 +101,434 @@ char *serial_port_get_description(struct sp_port *port) {
 	return full_description;
 }
 
+char *serial_port_get_id(struct sp_port *port) {
+	serial_port_details_t details;
+	serial_port_get_details(port, &details);
+	return serial_linux_id(&details);
+}
+
+char *serial_port_get_description(struct sp_port *port) {
+	serial_port_details_t details;
+	serial_port_get_details(port, &details);
+	return serial_linux_description(&details);
+}
+
+static cJSON *serial_linux_details_json(const serial_port_details_t *details) {
+	char *id		  = serial_linux_id(details);
+	char *description = serial_linux_description(details);
+	cJSON *item		  = serial_port_details_to_json(details, id, description);
+	free(id);
+	free(description);
+	return item;
+}
+
+bool serial_port_get_virtual(const char *port_name, struct sp_port **port) {
+	// only PTYs, e.g. created by socat, a replayed capture or a benchmark - not any device the page names
+	char real[PATH_MAX];
+	struct stat st;
+	if (realpath(port_name, real) == NULL || strncmp(real, "/dev/pts/", sizeof("/dev/pts/") - 1) != 0)
+		return false;
+	if (stat(real, &st) != 0 || !S_ISCHR(st.st_mode))
+		return false;
+	const char *base = strrchr(port_name, '/');
+	base			 = base != NULL ? base + 1 : port_name;
+
+	struct sp_port *virtual = calloc(1, sizeof(*virtual));
+	if (virtual == NULL)
+		return false;
+	virtual->name		 = strdup(port_name);
+	virtual->description = strdup(base);
+	virtual->transport	 = SP_TRANSPORT_NATIVE;
+	virtual->fd			 = -1;
+	if (virtual->name == NULL || virtual->description == NULL) {
+		sp_free_port(virtual);
+		return false;
+	}
+	*port = virtual;
+	return true;
+}
+
+static bool serial_linux_set_async_low_latency(int fd, bool enable) {
+	// not every driver supports it, e.g. most USB serial drivers ignore it
+	struct serial_struct serinfo;
+	if (ioctl(fd, TIOCGSERIAL, &serinfo) != 0)
+		return false;
+	if (enable)
+		serinfo.flags |= ASYNC_LOW_LATENCY;
+	else
+		serinfo.flags &= ~ASYNC_LOW_LATENCY;
+	if (ioctl(fd, TIOCSSERIAL, &serinfo) != 0)
+		return false;
+	return ioctl(fd, TIOCGSERIAL, &serinfo) == 0 && !(serinfo.flags & ASYNC_LOW_LATENCY) == !enable;
+}
+
+static uint8_t serial_linux_set_thread(pthread_t thread, uint8_t options, uint8_t priority, int8_t cpu) {
+	uint8_t applied = 0;
+	struct sched_param param;
+	if (options & SERIAL_LL_RT_PRIORITY) {
+		// needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+		param.sched_priority = priority ? priority : 1;
+		if (pthread_setschedparam(thread, SCHED_FIFO, &param) == 0)
+			applied |= SERIAL_LL_RT_PRIORITY;
+	} else {
+		param.sched_priority = 0;
+		pthread_setschedparam(thread, SCHED_OTHER, &param);
+	}
+	if ((options & SERIAL_LL_CPU_PIN) && cpu >= 0 && cpu < CPU_SETSIZE) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		if (pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0)
+			applied |= SERIAL_LL_CPU_PIN;
+	}
+	return applied;
+}
+
+// the reactor thread reads all ports - it runs with what any of them asked for, until the last one is done with it
+static pthread_mutex_t reactor_sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t reactor_priority_ports[SERIAL_RT_PRIORITY_MAX + 1]; // ports holding each priority
+static uint8_t reactor_priority	  = 0;
+static uint32_t reactor_cpu_ports = 0; // ports holding the CPU pin
+static int8_t reactor_cpu		  = -1;
+static cpu_set_t reactor_cpus; // the CPUs the reactor was allowed to run on before it was pinned
+
+static uint8_t
+serial_linux_set_reactor(serial_port_t *serial, pthread_t thread, uint8_t options, uint8_t priority, int8_t cpu) {
+	uint8_t applied = 0;
+	pthread_mutex_lock(&reactor_sched_lock);
+	// whatever the port held before is given back first
+	if (serial->reader_priority != 0)
+		reactor_priority_ports[serial->reader_priority]--;
+	if (serial->reader_cpu >= 0)
+		reactor_cpu_ports--;
+	serial->reader_priority = 0;
+	serial->reader_cpu		= -1;
+
+	if (options & SERIAL_LL_RT_PRIORITY) {
+		priority = priority ? priority : 1;
+		if (priority <= SERIAL_RT_PRIORITY_MAX) {
+			reactor_priority_ports[priority]++;
+			serial->reader_priority = priority;
+		}
+	}
+	uint8_t top = SERIAL_RT_PRIORITY_MAX;
+	while (top != 0 && reactor_priority_ports[top] == 0) {
+		top--;
+	}
+	if (top != reactor_priority) {
+		struct sched_param param = {.sched_priority = top};
+		// needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+		if (pthread_setschedparam(thread, top != 0 ? SCHED_FIFO : SCHED_OTHER, &param) == 0) {
+			reactor_priority = top;
+		} else if (serial->reader_priority != 0) {
+			// the others keep what they had
+			reactor_priority_ports[serial->reader_priority]--;
+			serial->reader_priority = 0;
+		}
+	}
+	if (serial->reader_priority != 0)
+		applied |= SERIAL_LL_RT_PRIORITY;
+
+	if ((options & SERIAL_LL_CPU_PIN) && cpu >= 0 && cpu < CPU_SETSIZE) {
+		bool pinned = reactor_cpu == cpu;
+		// a thread can only be pinned to one CPU - the first port to ask for it decides which;
+		// the affinity it had (e.g. from cgroups or taskset) is remembered, to go back to it later
+		if (!pinned && reactor_cpu_ports == 0 &&
+			(reactor_cpu >= 0 || pthread_getaffinity_np(thread, sizeof(reactor_cpus), &reactor_cpus) == 0)) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(cpu, &cpus);
+			if ((pinned = pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0))
+				reactor_cpu = cpu;
+		}
+		if (pinned) {
+			reactor_cpu_ports++;
+			serial->reader_cpu = cpu;
+			applied |= SERIAL_LL_CPU_PIN;
+		}
+	}
+	if (reactor_cpu_ports == 0 && reactor_cpu >= 0) {
+		// nobody needs the pin anymore
+		if (pthread_setaffinity_np(thread, sizeof(reactor_cpus), &reactor_cpus) == 0)
+			reactor_cpu = -1;
+	}
+	pthread_mutex_unlock(&reactor_sched_lock);
+	return applied;
+}
+
+uint8_t
+serial_port_set_low_latency(serial_port_t *serial, uint8_t options, uint32_t baudrate, uint8_t priority, int8_t cpu) {
+	int fd;
+	if (sp_get_port_handle(serial->port, &fd) != SP_OK)
+		return 0;
+	uint8_t applied = 0;
+	if (serial_linux_set_async_low_latency(fd, options & SERIAL_LL_ASYNC_LOW_LATENCY) &&
+		(options & SERIAL_LL_ASYNC_LOW_LATENCY))
+		applied |= SERIAL_LL_ASYNC_LOW_LATENCY;
+	if ((options & SERIAL_LL_EXACT_BAUD) && serial_linux_set_exact_baud(fd, baudrate))
+		applied |= SERIAL_LL_EXACT_BAUD;
+
+	// the reader is either the port's own thread, or the reactor shared by all ports
+	pthread_t reactor = serial_reactor_get_thread != NULL ? serial_reactor_get_thread() : 0;
+	if (serial->thread != 0)
+		applied |= serial_linux_set_thread(serial->thread, options, priority, cpu);
+	else if (reactor != 0)
+		applied |= serial_linux_set_reactor(serial, reactor, options, priority, cpu);
+	// the port's RX sender passes the data on - at a lower priority, it would be the one that waits
+	if (serial->rx.thread != 0) {
+		uint8_t sender = serial_linux_set_thread(serial->rx.thread, options & SERIAL_LL_RT_PRIORITY, priority, -1);
+		if (!(sender & SERIAL_LL_RT_PRIORITY))
+			applied &= ~SERIAL_LL_RT_PRIORITY;
+	}
+	return applied;
+}
+
+void serial_port_release_low_latency(serial_port_t *serial) {
+	pthread_t reactor = serial_reactor_get_thread != NULL ? serial_reactor_get_thread() : 0;
+	if (reactor != 0 && (serial->reader_priority != 0 || serial->reader_cpu >= 0))
+		serial_linux_set_reactor(serial, reactor, 0, 0, -1);
+}
+
+static pthread_once_t serial_linux_wake_once = PTHREAD_ONCE_INIT;
+
+static void serial_linux_wake_handler(int sig) {}
+
+static void serial_linux_wake_init() {
+	// without SA_RESTART, so that the blocked ioctl() returns EINTR
+	struct sigaction action = {.sa_handler = serial_linux_wake_handler};
+	sigemptyset(&action.sa_mask);
+	sigaction(SERIAL_WAKE_SIGNAL, &action, NULL);
+}
+
+bool serial_port_get_signal_counts(serial_port_t *serial, uint32_t *counts) {
+	int fd;
+	struct serial_icounter_struct icount;
+	if (sp_get_port_handle(serial->port, &fd) != SP_OK || ioctl(fd, TIOCGICOUNT, &icount) != 0)
+		return false;
+	counts[0] = icount.cts;
+	counts[1] = icount.dsr;
+	counts[2] = icount.dcd;
+	counts[3] = icount.rng;
+	return true;
+}
+
+bool serial_port_wait_signals(serial_port_t *serial, uint8_t mask) {
+	pthread_once(&serial_linux_wake_once, serial_linux_wake_init);
+	int fd;
+	if (sp_get_port_handle(serial->port, &fd) != SP_OK)
+		return false;
+	int lines = 0;
+	if (mask & SP_SIG_CTS)
+		lines |= TIOCM_CTS;
+	if (mask & SP_SIG_DSR)
+		lines |= TIOCM_DSR;
+	if (mask & SP_SIG_DCD)
+		lines |= TIOCM_CD;
+	if (mask & SP_SIG_RI)
+		lines |= TIOCM_RI;
+	// returns once any of the lines changes; PTYs and some USB drivers don't support it
+	return ioctl(fd, TIOCMIWAIT, lines) == 0 || errno == EINTR;
+}
+
+void serial_port_wake_signals(pthread_t thread) {
+	// the handler has to be there before the signal is sent, or it would kill the process
+	pthread_once(&serial_linux_wake_once, serial_linux_wake_init);
+	pthread_kill(thread, SERIAL_WAKE_SIGNAL);
+}
+
+static int sysfs_read(int dir_fd, const char *name, char *buf, int size) {
+	int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	int len = read(fd, buf, size - 1);
+	close(fd);
+	if (len < 0)
+		return -1;
+	while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == ' '))
+		len--;
+	buf[len] = '\0';
+	return len;
+}
+
+static int sysfs_read_int(int dir_fd, const char *name, int base) {
+	char buf[16];
+	if (sysfs_read(dir_fd, name, buf, sizeof(buf)) <= 0)
+		return -1;
+	return strtol(buf, NULL, base);
+}
+
+static bool sysfs_link_name(int dir_fd, const char *name, char *buf, int size) {
+	char target[PATH_MAX];
+	int len = readlinkat(dir_fd, name, target, sizeof(target) - 1);
+	if (len < 0)
+		return false;
+	target[len]		 = '\0';
+	const char *base = strrchr(target, '/');
+	base			 = base != NULL ? base + 1 : target;
+	snprintf(buf, size, "%s", base);
+	return true;
+}
+
+static int sysfs_open_usb_device(const char *tty) {
+	// the tty's device is a USB interface (or a port below it) - find the USB device itself
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s/device", serial_linux_sysfs_tty, tty);
+	char real[PATH_MAX];
+	if (realpath(path, real) == NULL)
+		return -1;
+	for (int depth = 0; depth < 4; depth++) {
+		char *slash = strrchr(real, '/');
+		if (slash == NULL || slash == real)
+			return -1;
+		*slash = '\0';
+		int fd = open(real, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd == -1)
+			return -1;
+		if (faccessat(fd, "idVendor", F_OK, 0) == 0)
+			return fd;
+		close(fd);
+	}
+	return -1;
+}
+
+static cJSON *serial_linux_usb_json(const char *name, int usb_fd, int vid, int pid) {
+	char manufacturer[256];
+	char product[256];
+	char serial[256];
+	bool has_manufacturer = sysfs_read(usb_fd, "manufacturer", manufacturer, sizeof(manufacturer)) >= 0;
+	bool has_product	  = sysfs_read(usb_fd, "product", product, sizeof(product)) >= 0;
+	bool has_serial		  = sysfs_read(usb_fd, "serial", serial, sizeof(serial)) >= 0;
+
+	serial_port_details_t details = {
+		.name			  = name,
+		.transport		  = SP_TRANSPORT_USB,
+		.usb_bus		  = sysfs_read_int(usb_fd, "busnum", 10),
+		.usb_address	  = sysfs_read_int(usb_fd, "devnum", 10),
+		.usb_vid		  = vid,
+		.usb_pid		  = pid,
+		.usb_manufacturer = has_manufacturer ? manufacturer : NULL,
+		.usb_product	  = has_product ? product : NULL,
+		.usb_serial		  = has_serial ? serial : NULL,
+	};
+	return serial_linux_details_json(&details);
+}
+
+static cJSON *serial_linux_native_json(const char *name) {
+	serial_port_details_t details = {
+		.name		 = name,
+		.transport	 = SP_TRANSPORT_NATIVE,
+		.usb_bus	 = -1,
+		.usb_address = -1,
+		.usb_vid	 = -1,
+		.usb_pid	 = -1,
+	};
+	return serial_linux_details_json(&details);
+}
+
+static cJSON *serial_linux_port_json(int class_fd, const char *tty, const serial_filter_t *filters, int filters_len) {
+	char name[PATH_MAX];
+	snprintf(name, sizeof(name), "/dev/%s", tty);
+
+	// each bit is a filter that can still match the port
+	uint32_t mask = serial_filter_name(filters, filters_len, UINT32_MAX, name);
+	if (mask == 0)
+		return NULL;
+
+	// skip virtual terminals, like libserialport does (Bluetooth ports are virtual, too)
+	char target[PATH_MAX];
+	int len = readlinkat(class_fd, tty, target, sizeof(target) - 1);
+	if (len < 0)
+		return NULL;
+	target[len]		  = '\0';
+	bool is_bluetooth = strncmp(tty, "rfcomm", 6) == 0;
+	if (strstr(target, "/virtual/") != NULL && !is_bluetooth)
+		return NULL;
+
+	if (is_bluetooth) {
+		mask = serial_filter_transport(filters, filters_len, mask, SP_TRANSPORT_BLUETOOTH);
+		if (mask == 0)
+			return NULL;
+		// rare enough to let libserialport find the details
+		struct sp_port *port;
+		if (sp_get_port_by_name(name, &port) != SP_OK)
+			return NULL;
+		cJSON *item = serial_port_to_json(port);
+		sp_free_port(port);
+		return item;
+	}
+
+	int tty_fd = openat(class_fd, tty, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (tty_fd == -1)
+		return NULL;
+	cJSON *item = NULL;
+
+	char subsystem[64];
+	if (!sysfs_link_name(tty_fd, "device/subsystem", subsystem, sizeof(subsystem)))
+		goto end;
+	bool is_usb = strcmp(subsystem, "usb") == 0 || strcmp(subsystem, "usb-serial") == 0;
+
+	mask = serial_filter_transport(filters, filters_len, mask, is_usb ? SP_TRANSPORT_USB : SP_TRANSPORT_NATIVE);
+	if (mask == 0)
+		goto end;
+
+	if (!is_usb) {
+		char driver[64];
+		// 8250 ports are registered even if there's no UART; the kernel reports their type without opening them
+		if (sysfs_link_name(tty_fd, "device/driver", driver, sizeof(driver)) && strcmp(driver, "serial8250") == 0) {
+			if (sysfs_read_int(tty_fd, "type", 10) == 0)
+				goto end;
+		}
+		item = serial_linux_native_json(name);
+		goto end;
+	}
+
+	int usb_fd = sysfs_open_usb_device(tty);
+	if (usb_fd == -1) {
+		item = serial_linux_native_json(name);
+		goto end;
+	}
+	// check the IDs before reading any strings
+	int vid = sysfs_read_int(usb_fd, "idVendor", 16);
+	int pid = sysfs_read_int(usb_fd, "idProduct", 16);
+	mask	= serial_filter_usb_id(filters, filters_len, mask, vid, pid);
+	if (mask != 0) {
+		char serial[256];
+		if (filters_len != 0) {
+			bool has_serial = sysfs_read(usb_fd, "serial", serial, sizeof(serial)) >= 0;
+			mask			= serial_filter_serial(filters, filters_len, mask, has_serial ? serial : NULL);
+		}
+		if (mask != 0)
+			item = serial_linux_usb_json(name, usb_fd, vid, pid);
+	}
+	close(usb_fd);
+
+end:
+	close(tty_fd);
+	return item;
+}
+
+cJSON *serial_list_ports_platform(const serial_filter_t *filters, int filters_len) {
+	// walk sysfs directly, so that non-matching ports are never probed
+	DIR *dir = opendir(serial_linux_sysfs_tty);
+	if (dir == NULL)
+		return NULL;
+
+	cJSON *data = cJSON_CreateArray();
+	if (data == NULL)
+		goto end;
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+		cJSON *item = serial_linux_port_json(dirfd(dir), entry->d_name, filters, filters_len);
+		if (item != NULL)
+			cJSON_AddItemToArray(data, item);
+	}
+
+end:
+	closedir(dir);
+	return data;
+}
+
 #endif
@@ -0,0 +1,26 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#ifdef __linux__
+
+#include "serial.h"
+
+// struct termios2, with the layout and CBAUD/BOTHER values of the architecture;
+// can't be included along with <termios.h>, which libserialport's internals need
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+bool serial_linux_set_exact_baud(int fd, uint32_t baudrate) {
+	struct termios2 tio;
+	if (ioctl(fd, TCGETS2, &tio) != 0)
+		return false;
+	tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+	tio.c_ispeed = baudrate;
+	tio.c_ospeed = baudrate;
+	if (ioctl(fd, TCSETS2, &tio) != 0)
+		return false;
+	// the driver may round it to what the hardware can do
+	return ioctl(fd, TCGETS2, &tio) == 0 && tio.c_ospeed == baudrate;
+}
+
+#endif
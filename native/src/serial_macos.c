@@ -8,6 +8,8 @@
 
 #include "serial.h"
 
+#include <fcntl.h>
+
 char *serial_port_get_id(struct sp_port *port) {
 	const char *name			= sp_get_port_name(port);
 	enum sp_transport transport = sp_get_port_transport(port);
@@ -92,4 +94,51 @@ void serial_port_fix_details(struct sp_port *port, const char *id) {
 	// No additional details to fix on macOS - libserialport handles it
 }
 
+bool serial_port_add_wake(serial_port_t *serial) {
+	struct sp_event_set *event_set = serial->event_set;
+	int *fds					   = malloc(2 * sizeof(int));
+	if (fds == NULL)
+		return false;
+	if (pipe(fds) != 0) {
+		free(fds);
+		return false;
+	}
+	for (int i = 0; i < 2; i++) {
+		fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[i], F_SETFL, O_NONBLOCK);
+	}
+
+	// appended the way sp_add_port_events() does it, so that sp_free_event_set() frees it along
+	event_handle *handles = realloc(event_set->handles, (event_set->count + 1) * sizeof(event_handle));
+	if (handles != NULL)
+		event_set->handles = handles;
+	enum sp_event *masks = realloc(event_set->masks, (event_set->count + 1) * sizeof(enum sp_event));
+	if (masks != NULL)
+		event_set->masks = masks;
+	if (handles == NULL || masks == NULL) {
+		close(fds[0]);
+		close(fds[1]);
+		free(fds);
+		return false;
+	}
+	// the read end stays readable once written to, so that every later sp_wait() returns too
+	handles[event_set->count] = fds[0];
+	masks[event_set->count]	  = SP_EVENT_RX_READY;
+	event_set->count++;
+	serial->wake = fds;
+	return true;
+}
+
+void serial_port_wake(serial_port_t *serial) {
+	int *fds = serial->wake;
+	write(fds[1], "", 1);
+}
+
+void serial_port_free_wake(serial_port_t *serial) {
+	int *fds = serial->wake;
+	close(fds[0]);
+	close(fds[1]);
+	free(fds);
+}
+
 #endif
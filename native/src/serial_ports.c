@@ -0,0 +1,153 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+static pthread_mutex_t ports_mutex = PTHREAD_MUTEX_INITIALIZER;
+// last enumerated port list, and the same list serialized
+static cJSON *ports_list = NULL;
+static char *ports_json	 = NULL;
+// the hotplug monitor was started (or at least tried to)
+static bool ports_watched = false;
+// the hotplug monitor is running, so the cached list can be trusted
+static bool ports_live = false;
+// the cached list reflects the last hotplug event
+static bool ports_valid = false;
+
+static cJSON *serial_ports_diff(cJSON *from, cJSON *to) {
+	// find ports in 'to' that aren't in 'from'
+	cJSON *diff = cJSON_CreateArray();
+	if (diff == NULL)
+		return NULL;
+	cJSON *item;
+	cJSON_ArrayForEach(item, to) {
+		bool found = false;
+		cJSON *other;
+		cJSON_ArrayForEach(other, from) {
+			if (cJSON_Compare(item, other, true)) {
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			cJSON_AddItemToArray(diff, cJSON_Duplicate(item, true));
+	}
+	return diff;
+}
+
+static bool serial_ports_refresh(cJSON **added, cJSON **removed) {
+	cJSON *list = serial_list_ports_json(NULL, 0);
+	if (list == NULL)
+		return false;
+	char *json = cJSON_PrintUnformatted(list);
+	if (json == NULL) {
+		cJSON_Delete(list);
+		return false;
+	}
+	if (added != NULL && ports_list != NULL) {
+		*added	 = serial_ports_diff(ports_list, list);
+		*removed = serial_ports_diff(list, ports_list);
+	}
+	cJSON_Delete(ports_list);
+	free(ports_json);
+	ports_list	= list;
+	ports_json	= json;
+	ports_valid = true;
+	return true;
+}
+
+static cJSON *serial_ports_filter(const serial_filter_t *filters, int filters_len) {
+	cJSON *data = cJSON_CreateArray();
+	if (data == NULL)
+		return NULL;
+	cJSON *item;
+	cJSON_ArrayForEach(item, ports_list) {
+		if (serial_filter_match_json(filters, filters_len, item))
+			cJSON_AddItemToArray(data, cJSON_Duplicate(item, true));
+	}
+	return data;
+}
+
+bool serial_list_ports_send(const char *id, const serial_filter_t *filters, int filters_len) {
+	cJSON *data = NULL;
+	bool ret	= false;
+	pthread_mutex_lock(&ports_mutex);
+
+	if (!ports_watched) {
+		// start watching before the first enumeration, so that no change is missed
+		ports_watched = true;
+		if (serial_hotplug_start != NULL)
+			ports_live = serial_hotplug_start();
+	}
+
+	if (!ports_live || !ports_valid) {
+		if (filters_len != 0) {
+			// only probe the matching ports, don't touch the cache
+			data = serial_list_ports_json(filters, filters_len);
+			goto send;
+		}
+		// without a hotplug monitor, enumerate the ports every time
+		if (!serial_ports_refresh(NULL, NULL))
+			goto end;
+	}
+
+	if (filters_len != 0) {
+		data = serial_ports_filter(filters, filters_len);
+		goto send;
+	}
+
+	// the cached list is already serialized
+	json_writer_t *writer = stdmsg_begin(id);
+	if (writer == NULL)
+		goto end;
+	json_add_raw(writer, "data", ports_json);
+	ret = stdmsg_end(writer);
+	goto end;
+
+send:
+	if (data == NULL)
+		goto end;
+	if ((writer = stdmsg_begin(id)) == NULL)
+		goto end;
+	json_add_cjson(writer, "data", data);
+	ret = stdmsg_end(writer);
+
+end:
+	pthread_mutex_unlock(&ports_mutex);
+	cJSON_Delete(data);
+	return ret;
+}
+
+void serial_ports_changed() {
+	cJSON *added   = NULL;
+	cJSON *removed = NULL;
+
+	pthread_mutex_lock(&ports_mutex);
+	if (!serial_ports_refresh(&added, &removed)) {
+		// try again on the next listPorts
+		ports_valid = false;
+	}
+	pthread_mutex_unlock(&ports_mutex);
+
+	if (added == NULL || removed == NULL)
+		goto end;
+	if (cJSON_GetArraySize(added) == 0 && cJSON_GetArraySize(removed) == 0)
+		goto end;
+
+	cJSON *data = cJSON_CreateObject();
+	if (data == NULL)
+		goto end;
+	cJSON_AddItemToObject(data, "added", added);
+	cJSON_AddItemToObject(data, "removed", removed);
+	stdmsg_send_event("portsChanged", data);
+	return;
+
+end:
+	cJSON_Delete(added);
+	cJSON_Delete(removed);
+}
+
+void serial_ports_unwatched() {
+	pthread_mutex_lock(&ports_mutex);
+	ports_live = false;
+	pthread_mutex_unlock(&ports_mutex);
+}
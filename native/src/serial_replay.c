@@ -0,0 +1,202 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+// the host opens the PTY with serial_port_get_virtual(), which only Linux has
+#ifdef __linux__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // posix_openpt()
+#endif
+
+#include "serial.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+
+typedef struct serial_replay {
+	struct serial_replay *next;
+	char *port_name;	   // PTY that the page opens
+	int master_fd;		   // written by the replay thread
+	int slave_fd;		   // kept open, so that the PTY doesn't hang up while the page has it closed
+	FILE *file;			   // capture being replayed
+	double speed;		   // 1 - original timing, 2 - twice as fast, 0 - as fast as possible
+	_Atomic bool stop;	   // the replay thread should finish
+	pthread_t thread;	   // replay thread
+	uint64_t opened_us;	   // when the page first opened the PTY, 0 - not yet
+	pthread_mutex_t mutex; // protects opened_us
+	pthread_cond_t cond;   // signalled when the page opens the PTY
+} serial_replay_t;
+
+static pthread_mutex_t replay_lock = PTHREAD_MUTEX_INITIALIZER;
+static serial_replay_t *replays	   = NULL;
+
+static void serial_replay_poll(serial_replay_t *replay, short events, int timeout_ms) {
+	// whatever the page writes is dropped, as nothing else would read it
+	struct pollfd pfd = {.fd = replay->master_fd, .events = POLLIN | events};
+	if (poll(&pfd, 1, timeout_ms) <= 0 || !(pfd.revents & POLLIN))
+		return;
+	uint8_t buf[256];
+	while (read(replay->master_fd, buf, sizeof(buf)) > 0) {}
+}
+
+static void serial_replay_sleep(serial_replay_t *replay, uint64_t until_us) {
+	uint64_t now;
+	while (!atomic_load(&replay->stop) && (now = utils_time_us()) < until_us) {
+		uint64_t wait_ms = (until_us - now) / 1000;
+		if (wait_ms == 0) {
+			// keep the sub-millisecond gaps of fast baud rates
+			usleep(until_us - now);
+			break;
+		}
+		serial_replay_poll(replay, 0, wait_ms < SERIAL_REPLAY_POLL_MS ? wait_ms : SERIAL_REPLAY_POLL_MS);
+	}
+}
+
+static void *serial_replay_thread(void *arg) {
+	serial_replay_t *replay = arg;
+	uint8_t *data			= malloc(SERIAL_CAPTURE_SLOT_SIZE);
+
+	// the original timing starts once the page is there to see it, not in one burst of what it missed
+	pthread_mutex_lock(&replay->mutex);
+	while (!atomic_load(&replay->stop) && replay->opened_us == 0) {
+		utils_cond_wait_us(&replay->cond, &replay->mutex, SERIAL_REPLAY_POLL_MS * 1000);
+	}
+	uint64_t start_us = replay->opened_us;
+	pthread_mutex_unlock(&replay->mutex);
+
+	// the capture may have started long before the page opened the port
+	serial_capture_record_t record;
+	int64_t first_us = -1;
+	while (data != NULL && !atomic_load(&replay->stop) && fread(&record, sizeof(record), 1, replay->file) == 1) {
+		if (record.len > SERIAL_CAPTURE_SLOT_SIZE || fread(data, 1, record.len, replay->file) != record.len)
+			break;
+		if (first_us == -1 && (record.type == SERIAL_CAPTURE_OPEN || record.type == SERIAL_CAPTURE_RX))
+			first_us = record.time_us;
+		// only the port's side of the traffic is replayed
+		if (record.type != SERIAL_CAPTURE_RX)
+			continue;
+		if (replay->speed > 0)
+			serial_replay_sleep(replay, start_us + (uint64_t)((record.time_us - first_us) / replay->speed));
+		uint32_t written = 0;
+		while (!atomic_load(&replay->stop) && written < record.len) {
+			ssize_t ret = write(replay->master_fd, data + written, record.len - written);
+			if (ret > 0)
+				written += ret;
+			else if (ret < 0 && errno != EAGAIN && errno != EINTR)
+				goto end;
+			else
+				// the page isn't reading - wait for the PTY to take more
+				serial_replay_poll(replay, POLLOUT, SERIAL_REPLAY_POLL_MS);
+		}
+	}
+
+end:
+	free(data);
+	stdmsg_send_log("Replay on %s finished", replay->port_name);
+	// keep the port until it's stopped, the page may still have it open
+	while (!atomic_load(&replay->stop)) {
+		serial_replay_poll(replay, 0, SERIAL_REPLAY_POLL_MS);
+	}
+	return NULL;
+}
+
+static void serial_replay_free(serial_replay_t *replay) {
+	if (replay->slave_fd != -1)
+		close(replay->slave_fd);
+	if (replay->master_fd != -1)
+		close(replay->master_fd);
+	if (replay->file != NULL)
+		fclose(replay->file);
+	pthread_cond_destroy(&replay->cond);
+	pthread_mutex_destroy(&replay->mutex);
+	free(replay->port_name);
+	free(replay);
+}
+
+const char *serial_replay_start(const char *path, double speed) {
+	serial_replay_t *replay = calloc(1, sizeof(*replay));
+	if (replay == NULL)
+		return NULL;
+	replay->master_fd = -1;
+	replay->slave_fd  = -1;
+	replay->speed	  = speed;
+	atomic_init(&replay->stop, false);
+	pthread_mutex_init(&replay->mutex, NULL);
+	pthread_cond_init(&replay->cond, NULL);
+
+	char magic[sizeof(SERIAL_CAPTURE_MAGIC) - 1];
+	if ((replay->file = fopen(path, "rb")) == NULL)
+		goto error;
+	if (fread(magic, sizeof(magic), 1, replay->file) != 1 || memcmp(magic, SERIAL_CAPTURE_MAGIC, sizeof(magic)) != 0)
+		goto error;
+
+	if ((replay->master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1)
+		goto error;
+	if (grantpt(replay->master_fd) != 0 || unlockpt(replay->master_fd) != 0)
+		goto error;
+	const char *name = ptsname(replay->master_fd);
+	if (name == NULL || (replay->port_name = strdup(name)) == NULL)
+		goto error;
+	if ((replay->slave_fd = open(replay->port_name, O_RDWR | O_NOCTTY | O_CLOEXEC)) == -1)
+		goto error;
+	// no line discipline, so that the data passes through unchanged
+	struct termios tio;
+	if (tcgetattr(replay->slave_fd, &tio) != 0)
+		goto error;
+	cfmakeraw(&tio);
+	if (tcsetattr(replay->slave_fd, TCSANOW, &tio) != 0)
+		goto error;
+
+	if (!utils_thread_create(&replay->thread, serial_replay_thread, replay))
+		goto error;
+	pthread_mutex_lock(&replay_lock);
+	replay->next = replays;
+	replays		 = replay;
+	pthread_mutex_unlock(&replay_lock);
+	return replay->port_name;
+
+error:
+	serial_replay_free(replay);
+	return NULL;
+}
+
+void serial_replay_opened(const char *port_name) {
+	pthread_mutex_lock(&replay_lock);
+	serial_replay_t *replay = replays;
+	while (replay != NULL && strcmp(replay->port_name, port_name) != 0) {
+		replay = replay->next;
+	}
+	if (replay != NULL) {
+		// only the first open starts the clock
+		pthread_mutex_lock(&replay->mutex);
+		if (replay->opened_us == 0) {
+			replay->opened_us = utils_time_us();
+			pthread_cond_broadcast(&replay->cond);
+		}
+		pthread_mutex_unlock(&replay->mutex);
+	}
+	pthread_mutex_unlock(&replay_lock);
+}
+
+bool serial_replay_stop(const char *port_name) {
+	pthread_mutex_lock(&replay_lock);
+	serial_replay_t **prev = &replays;
+	while (*prev != NULL && strcmp((*prev)->port_name, port_name) != 0) {
+		prev = &(*prev)->next;
+	}
+	serial_replay_t *replay = *prev;
+	if (replay != NULL)
+		*prev = replay->next;
+	pthread_mutex_unlock(&replay_lock);
+	if (replay == NULL)
+		return false;
+
+	atomic_store(&replay->stop, true);
+	// returns within SERIAL_REPLAY_POLL_MS
+	pthread_join(replay->thread, NULL);
+	serial_replay_free(replay);
+	return true;
+}
+
+#endif
@@ -0,0 +1,155 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+typedef struct {
+	serial_port_t *serial;
+	uint32_t session;
+} serial_resume_timer_t;
+
+static void *serial_resume_thread(void *arg) {
+	serial_resume_timer_t *timer = arg;
+	serial_port_t *serial		 = timer->serial;
+	serial_resume_t *resume		 = &serial->resume;
+
+	pthread_mutex_lock(&resume->mutex);
+	uint64_t deadline = utils_time_us() + resume->grace_ms * 1000ull;
+	uint64_t now;
+	while (resume->detached && resume->session == timer->session && (now = utils_time_us()) < deadline) {
+		utils_cond_wait_us(&resume->cond, &resume->mutex, deadline - now);
+	}
+	// whoever clears the flag decides what happens to the port
+	bool expired = resume->detached && resume->session == timer->session;
+	if (expired)
+		resume->detached = false;
+	pthread_mutex_unlock(&resume->mutex);
+	free(timer);
+
+	if (expired) {
+		stdmsg_send_log("Port %s wasn't resumed, closing", serial->port_name);
+		SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_CLOSE, NULL, 0, utils_time_us());
+		serial_close(serial);
+	}
+	return NULL;
+}
+
+void serial_resume_init(serial_port_t *serial) {
+	serial_resume_t *resume = &serial->resume;
+	resume->token			= NULL;
+	resume->grace_ms		= 0;
+	resume->detached		= false;
+	resume->session			= 0;
+	pthread_mutex_init(&resume->mutex, NULL);
+	pthread_cond_init(&resume->cond, NULL);
+}
+
+bool serial_resume_enable(serial_port_t *serial, uint32_t grace_ms) {
+	serial_resume_t *resume = &serial->resume;
+	if (grace_ms > SERIAL_RESUME_MAX_MS)
+		grace_ms = SERIAL_RESUME_MAX_MS;
+	// a new token for every open, so that an old session can't take over a new one
+	char *token = serial_auth_make_key(serial->port_name);
+	if (token == NULL)
+		return false;
+	pthread_mutex_lock(&resume->mutex);
+	free(resume->token);
+	resume->token	 = token;
+	resume->grace_ms = grace_ms;
+	pthread_mutex_unlock(&resume->mutex);
+	return true;
+}
+
+void serial_resume_disable(serial_port_t *serial) {
+	serial_resume_t *resume = &serial->resume;
+	pthread_mutex_lock(&resume->mutex);
+	free(resume->token);
+	resume->token	 = NULL;
+	resume->grace_ms = 0;
+	resume->detached = false;
+	pthread_cond_broadcast(&resume->cond);
+	pthread_mutex_unlock(&resume->mutex);
+}
+
+bool serial_resume_detach(serial_port_t *serial) {
+	serial_resume_t *resume = &serial->resume;
+	if (serial->port == NULL)
+		return false;
+	serial_resume_timer_t *timer = malloc(sizeof(*timer));
+	if (timer == NULL)
+		return false;
+
+	pthread_mutex_lock(&resume->mutex);
+	bool ret = resume->token != NULL;
+	if (ret) {
+		// set before the connection is cleared, so that the reader doesn't take it for a closed port
+		resume->detached = true;
+		timer->serial	 = serial;
+		timer->session	 = ++resume->session;
+		// given back to the page that resumes it
+		resume->rx_flow	   = serial->rx_flow;
+		resume->rx_credits = atomic_load(&serial->rx_credits);
+		resume->rx_bytes   = atomic_load(&serial->stats.rx_bytes);
+	}
+	pthread_mutex_unlock(&resume->mutex);
+	if (!ret) {
+		free(timer);
+		return false;
+	}
+
+	serial_set_conn(serial, NULL);
+	// buffer as much as the RX ring takes, there's nobody to grant credits
+	serial_rx_hold(serial, true);
+	serial_set_rx_flow(serial, 0);
+
+	pthread_t thread;
+	if (!utils_thread_create(&thread, serial_resume_thread, timer)) {
+		free(timer);
+		// nothing would close it - let the caller do it
+		pthread_mutex_lock(&resume->mutex);
+		resume->detached = false;
+		pthread_mutex_unlock(&resume->mutex);
+		return false;
+	}
+	pthread_detach(thread);
+	stdmsg_send_log("Port %s detached, waiting %u ms to be resumed", serial->port_name, resume->grace_ms);
+	return true;
+}
+
+bool serial_resume_attach(serial_port_t *serial, ws_cli_conn_t *conn, const char *token) {
+	serial_resume_t *resume = &serial->resume;
+	pthread_mutex_lock(&resume->mutex);
+	bool ret = resume->detached && resume->token != NULL && strcmp(resume->token, token) == 0;
+	if (ret) {
+		// set before the flag is cleared, so that the reader doesn't take it for a closed port
+		serial_set_conn(serial, conn);
+		resume->detached = false;
+		pthread_cond_broadcast(&resume->cond);
+	}
+	pthread_mutex_unlock(&resume->mutex);
+	if (!ret)
+		return false;
+
+	// the page's flow control again, less what was read for it meanwhile
+	uint64_t read	 = atomic_load(&serial->stats.rx_bytes) - resume->rx_bytes;
+	uint32_t credits = read < resume->rx_credits ? resume->rx_credits - read : 0;
+	serial_set_rx_credits(serial, resume->rx_flow, credits);
+	// the buffered data waits until the page sets the flow control or grants credits - it has no reader yet
+	return true;
+}
+
+bool serial_resume_cancel(serial_port_t *serial) {
+	serial_resume_t *resume = &serial->resume;
+	pthread_mutex_lock(&resume->mutex);
+	bool ret = resume->detached;
+	if (ret) {
+		resume->detached = false;
+		pthread_cond_broadcast(&resume->cond);
+	}
+	pthread_mutex_unlock(&resume->mutex);
+	if (!ret)
+		return false;
+
+	SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_CLOSE, NULL, 0, utils_time_us());
+	serial_close(serial);
+	return true;
+}
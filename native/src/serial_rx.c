@@ -0,0 +1,347 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+static inline uint8_t *serial_rx_ring(serial_rx_t *rx) {
+	return rx->buf + SERIAL_RX_HEADER_MAX;
+}
+
+static void serial_rx_send(serial_port_t *serial, uint8_t *data, uint32_t len, uint64_t time_us) {
+	// the bytes before the data are free (or the slot before the ring) - put the header there, instead of copying
+	uint8_t *frame = data - serial->rx.header;
+	if (serial->rx.flags & SERIAL_RX_TIMESTAMPS) {
+		frame[0] = WSM_DATA_TS;
+		memcpy(frame + 1, &time_us, sizeof(time_us));
+	} else {
+		frame[0] = WSM_DATA;
+	}
+	// a NULL connection would broadcast the data to all clients; read once, the port may be detached meanwhile
+	ws_cli_conn_t *conn = serial->conn;
+	if (conn == NULL)
+		return;
+	ws_sendframe_bin(conn, (const char *)frame, serial->rx.header + len);
+	SERIAL_STATS_ADD(serial, rx_frames, 1);
+	// the owner always goes first
+	if (atomic_load_explicit(&serial->subscribers.len, memory_order_relaxed) != 0)
+		serial_subscribers_send(serial, frame, serial->rx.header + len);
+}
+
+static uint32_t serial_rx_coalesce(serial_port_t *serial) {
+	serial_rx_t *rx = &serial->rx;
+	// wait for more data, unless there's enough already or the oldest byte is too old
+	if (rx->len < serial->coalesce.threshold) {
+		uint64_t now = utils_time_us();
+		if (now < rx->deadline) {
+			utils_cond_wait_us(&serial->rx_cond, &serial->rx_mutex, rx->deadline - now);
+			return 0;
+		}
+	}
+	return rx->len;
+}
+
+static uint32_t serial_rx_find_delimiter(serial_rx_t *rx, uint32_t limit) {
+	const serial_framing_t *framing = &rx->framing;
+	uint8_t *ring					= serial_rx_ring(rx);
+	uint32_t tail					= (rx->head + rx->size - rx->len) % rx->size;
+	uint8_t last					= framing->delimiter[framing->delimiter_len - 1];
+	// only look at what arrived since the last search
+	while (rx->scanned < limit) {
+		uint32_t start = (tail + rx->scanned) % rx->size;
+		uint32_t count = limit - rx->scanned;
+		if (count > rx->size - start)
+			count = rx->size - start;
+		// memchr() is vectorized by the libc, unlike a byte-by-byte loop
+		uint8_t *found = memchr(ring + start, last, count);
+		if (found == NULL) {
+			rx->scanned += count;
+			continue;
+		}
+		rx->scanned += found - (ring + start) + 1;
+		if (rx->scanned < framing->delimiter_len)
+			continue;
+		// check the rest of the delimiter, which may wrap around the ring
+		uint32_t pos = tail + rx->scanned - framing->delimiter_len;
+		uint8_t i;
+		for (i = 0; i < framing->delimiter_len - 1; i++) {
+			if (ring[(pos + i) % rx->size] != framing->delimiter[i])
+				break;
+		}
+		if (i == framing->delimiter_len - 1)
+			return rx->scanned;
+	}
+	return 0;
+}
+
+static uint32_t serial_rx_frame(serial_port_t *serial) {
+	serial_rx_t *rx = &serial->rx;
+	uint32_t max	= rx->framing.max_frame;
+	uint32_t len	= 0;
+	switch (rx->framing.mode) {
+		case SERIAL_FRAMING_DELIMITER:
+			len = serial_rx_find_delimiter(rx, rx->len < max ? rx->len : max);
+			break;
+
+		case SERIAL_FRAMING_IDLE_GAP: {
+			uint64_t now = utils_time_us();
+			if (now >= rx->last_us + rx->gap_us) {
+				len = rx->len;
+				break;
+			}
+			if (rx->len < max) {
+				// the deadline moves with every read, this only checks it again
+				utils_cond_wait_us(&serial->rx_cond, &serial->rx_mutex, rx->last_us + rx->gap_us - now);
+				return 0;
+			}
+			break;
+		}
+
+		case SERIAL_FRAMING_FIXED:
+			if (rx->len >= rx->framing.record_len)
+				len = rx->framing.record_len;
+			break;
+	}
+	if (len != 0 && len <= max)
+		return len;
+	if (rx->len < max) {
+		pthread_cond_wait(&serial->rx_cond, &serial->rx_mutex);
+		return 0;
+	}
+	// no end of frame in sight - send what fits, search the rest from the start
+	rx->scanned = max;
+	SERIAL_STATS_ADD(serial, rx_frames_cut, 1);
+	return max;
+}
+
+static uint64_t serial_rx_stamp(serial_rx_t *rx, uint64_t pos) {
+	// forget the reads that were sent completely; the oldest remaining one has the byte at pos
+	while (rx->stamps_len != 0) {
+		uint32_t index			 = (rx->stamps_head + SERIAL_RX_STAMPS - rx->stamps_len) % SERIAL_RX_STAMPS;
+		serial_rx_stamp_t *stamp = &rx->stamps[index];
+		if (stamp->end > pos || rx->stamps_len == 1)
+			return stamp->time_us;
+		rx->stamps_len--;
+	}
+	return 0;
+}
+
+static void *serial_rx_thread(void *arg) {
+	serial_port_t *serial = arg;
+	serial_rx_t *rx		  = &serial->rx;
+	bool framed			  = rx->framing.mode != SERIAL_FRAMING_NONE;
+
+	pthread_mutex_lock(&serial->rx_mutex);
+	while (!rx->stop) {
+		// a detached port keeps its data in the ring until it's resumed, and the page is reading again
+		if (rx->len == 0 || serial->conn == NULL || rx->held) {
+			pthread_cond_wait(&serial->rx_cond, &serial->rx_mutex);
+			continue;
+		}
+		uint32_t len = framed ? serial_rx_frame(serial) : serial_rx_coalesce(serial);
+		if (len == 0)
+			continue;
+
+		// send the buffered data, while the reader keeps filling the free space
+		uint32_t tail  = (rx->head + rx->size - rx->len) % rx->size;
+		uint32_t chunk = len;
+		if (chunk > rx->size - tail)
+			chunk = rx->size - tail;
+		bool was_full = rx->len == rx->size - rx->header;
+		// frames are stamped with the time of the read that got their first byte
+		uint64_t time_us	  = 0;
+		uint64_t time_wrap_us = 0;
+		if (rx->flags & SERIAL_RX_TIMESTAMPS) {
+			time_us		 = serial_rx_stamp(rx, rx->out);
+			time_wrap_us = serial_rx_stamp(rx, rx->out + chunk);
+		}
+		// whatever arrives while sending is newer than this
+		uint64_t send_us = framed ? 0 : utils_time_us();
+		pthread_mutex_unlock(&serial->rx_mutex);
+		uint8_t *ring = serial_rx_ring(rx);
+		if (chunk == len) {
+			serial_rx_send(serial, ring + tail, len, time_us);
+		} else if (framed) {
+			// a frame has to stay in one message - copy it in one piece
+			uint8_t *frame = rx->frame_buf + SERIAL_RX_HEADER_MAX;
+			memcpy(frame, ring + tail, chunk);
+			memcpy(frame + chunk, ring, len - chunk);
+			serial_rx_send(serial, frame, len, time_us);
+		} else {
+			serial_rx_send(serial, ring + tail, chunk, time_us);
+			serial_rx_send(serial, ring, len - chunk, time_wrap_us);
+		}
+		// the reactor stops polling a port with a full ring
+		if (was_full && serial_reactor_update != NULL)
+			serial_reactor_update(serial);
+		pthread_mutex_lock(&serial->rx_mutex);
+
+		rx->len -= len;
+		rx->out += len;
+		rx->scanned = rx->scanned > len ? rx->scanned - len : 0;
+		// the reader only starts the countdown for an empty ring - start it for the data that came meanwhile
+		if (!framed && rx->len != 0)
+			rx->deadline = send_us + serial->coalesce.deadline_us;
+		pthread_cond_broadcast(&serial->rx_cond);
+	}
+	pthread_mutex_unlock(&serial->rx_mutex);
+	return NULL;
+}
+
+bool serial_rx_start(serial_port_t *serial, uint32_t size, uint8_t flags, const serial_framing_t *framing) {
+	serial_rx_t *rx = &serial->rx;
+	if (size == 0)
+		size = SERIAL_RX_RING_SIZE;
+	if (size < SERIAL_RX_RING_MIN)
+		size = SERIAL_RX_RING_MIN;
+	if (size > SERIAL_RX_RING_MAX)
+		size = SERIAL_RX_RING_MAX;
+	// released by serial_rx_stop(), once nothing reads the port anymore
+	if (rx->buf_size < size) {
+		free(rx->buf);
+		if ((rx->buf = malloc(SERIAL_RX_HEADER_MAX + size)) == NULL) {
+			rx->buf_size = 0;
+			return false;
+		}
+		rx->buf_size = size;
+	}
+	if ((flags & SERIAL_RX_TIMESTAMPS) && rx->stamps == NULL &&
+		(rx->stamps = malloc(SERIAL_RX_STAMPS * sizeof(*rx->stamps))) == NULL)
+		return false;
+
+	memset(&rx->framing, 0, sizeof(rx->framing));
+	if (framing != NULL)
+		rx->framing = *framing;
+	if (rx->framing.max_frame == 0)
+		rx->framing.max_frame = SERIAL_FRAMING_MAX_FRAME;
+	if (rx->framing.mode == SERIAL_FRAMING_FIXED && rx->framing.max_frame < rx->framing.record_len)
+		rx->framing.max_frame = rx->framing.record_len;
+	// a frame has to fit in the ring, with room for the next one to arrive
+	if (rx->framing.max_frame > size / 2)
+		rx->framing.max_frame = size / 2;
+	if (rx->framing.mode != SERIAL_FRAMING_NONE && rx->frame_buf_size < rx->framing.max_frame) {
+		free(rx->frame_buf);
+		if ((rx->frame_buf = malloc(SERIAL_RX_HEADER_MAX + rx->framing.max_frame)) == NULL) {
+			rx->frame_buf_size = 0;
+			return false;
+		}
+		rx->frame_buf_size = rx->framing.max_frame;
+	}
+
+	rx->size		= size;
+	rx->head		= 0;
+	rx->len			= 0;
+	rx->flags		= flags;
+	rx->header		= flags & SERIAL_RX_TIMESTAMPS ? SERIAL_RX_HEADER_MAX : 1;
+	rx->scanned		= 0;
+	rx->stamps_head = 0;
+	rx->stamps_len	= 0;
+	rx->in			= 0;
+	rx->out			= 0;
+	rx->stop		= false;
+	rx->held		= false;
+	serial_rx_set_baudrate(serial, 0);
+	if (!utils_thread_create(&rx->thread, serial_rx_thread, serial)) {
+		rx->thread = 0;
+		return false;
+	}
+	return true;
+}
+
+void serial_rx_set_baudrate(serial_port_t *serial, uint32_t baudrate) {
+	serial_rx_t *rx = &serial->rx;
+	uint32_t gap_us = SERIAL_FRAMING_GAP_MIN_US;
+	if (rx->framing.gap_us != 0)
+		gap_us = rx->framing.gap_us;
+	else if (baudrate != 0 && baudrate <= 19200)
+		gap_us = (uint64_t)SERIAL_FRAMING_GAP_BITS_X10 * 100000 / baudrate;
+	pthread_mutex_lock(&serial->rx_mutex);
+	rx->gap_us = gap_us;
+	pthread_mutex_unlock(&serial->rx_mutex);
+}
+
+void serial_rx_hold(serial_port_t *serial, bool held) {
+	pthread_mutex_lock(&serial->rx_mutex);
+	serial->rx.held = held;
+	pthread_cond_broadcast(&serial->rx_cond);
+	pthread_mutex_unlock(&serial->rx_mutex);
+}
+
+void serial_rx_stop(serial_port_t *serial) {
+	serial_rx_t *rx = &serial->rx;
+	if (rx->thread == 0)
+		return;
+	pthread_mutex_lock(&serial->rx_mutex);
+	rx->stop = true;
+	pthread_cond_broadcast(&serial->rx_cond);
+	pthread_mutex_unlock(&serial->rx_mutex);
+	pthread_join(rx->thread, NULL);
+	rx->thread = 0;
+	// whatever wasn't sent yet is dropped
+	rx->len = 0;
+	// the reader is stopped before, so nothing can fill them anymore
+	free(rx->buf);
+	free(rx->frame_buf);
+	free(rx->stamps);
+	rx->buf			   = NULL;
+	rx->buf_size	   = 0;
+	rx->frame_buf	   = NULL;
+	rx->frame_buf_size = 0;
+	rx->stamps		   = NULL;
+}
+
+uint32_t serial_rx_reserve(serial_port_t *serial, uint8_t **data) {
+	serial_rx_t *rx = &serial->rx;
+	pthread_mutex_lock(&serial->rx_mutex);
+	// contiguous free space at the head, keeping the header bytes before the tail free
+	uint32_t space = rx->size - rx->header - rx->len;
+	if (space > rx->size - rx->head)
+		space = rx->size - rx->head;
+	*data = serial_rx_ring(rx) + rx->head;
+	pthread_mutex_unlock(&serial->rx_mutex);
+	return space;
+}
+
+void serial_rx_commit(serial_port_t *serial, uint32_t len, uint64_t time_us) {
+	serial_rx_t *rx = &serial->rx;
+	pthread_mutex_lock(&serial->rx_mutex);
+	uint32_t old_len = rx->len;
+	if (old_len == 0) {
+		// the first byte was just buffered, start counting down
+		rx->deadline = time_us + serial->coalesce.deadline_us;
+	}
+	rx->last_us = time_us;
+	rx->head	= (rx->head + len) % rx->size;
+	rx->len += len;
+	rx->in += len;
+	if (rx->flags & SERIAL_RX_TIMESTAMPS) {
+		if (rx->stamps_len == SERIAL_RX_STAMPS) {
+			// the sender is far behind - let the newest read cover this one too
+			rx->stamps[(rx->stamps_head + SERIAL_RX_STAMPS - 1) % SERIAL_RX_STAMPS].end = rx->in;
+		} else {
+			rx->stamps[rx->stamps_head] = (serial_rx_stamp_t){.end = rx->in, .time_us = time_us};
+			rx->stamps_head				= (rx->stamps_head + 1) % SERIAL_RX_STAMPS;
+			rx->stamps_len++;
+		}
+	}
+	if (rx->len > atomic_load_explicit(&serial->stats.rx_ring_high, memory_order_relaxed))
+		atomic_store_explicit(&serial->stats.rx_ring_high, rx->len, memory_order_relaxed);
+	// the sender only needs to know about new data, or reaching the threshold while it waits for the deadline;
+	// delimited and fixed-length frames may end with any read
+	bool wake = old_len == 0;
+	switch (rx->framing.mode) {
+		case SERIAL_FRAMING_NONE:
+			wake |= old_len < serial->coalesce.threshold && rx->len >= serial->coalesce.threshold;
+			break;
+		case SERIAL_FRAMING_DELIMITER:
+		case SERIAL_FRAMING_FIXED:
+			wake = true;
+			break;
+	}
+	if (wake)
+		pthread_cond_broadcast(&serial->rx_cond);
+	pthread_mutex_unlock(&serial->rx_mutex);
+}
+
+bool serial_rx_has_space(serial_port_t *serial) {
+	// checked without the lock - the sender wakes the reader up after freeing space anyway
+	return serial->rx.len < serial->rx.size - serial->rx.header;
+}
@@ -0,0 +1,145 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+static void serial_sequence_sleep(uint64_t until_us) {
+	// the scheduler may oversleep by a lot - wake up early, then wait for the exact time
+	uint64_t now = utils_time_us();
+	if (until_us > now + SERIAL_SEQ_SPIN_US)
+		usleep(until_us - now - SERIAL_SEQ_SPIN_US);
+	while (utils_time_us() < until_us) {}
+}
+
+static enum sp_return serial_sequence_signals(serial_port_t *serial, const uint8_t *args) {
+	if (args[0] <= 1 && sp_set_dtr(serial->port, args[0]) != SP_OK)
+		return SP_ERR_FAIL;
+	if (args[1] <= 1 && sp_set_rts(serial->port, args[1]) != SP_OK)
+		return SP_ERR_FAIL;
+	SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_SIGNALS, args, 2, utils_time_us());
+	return SP_OK;
+}
+
+static enum sp_return serial_sequence_break(serial_port_t *serial, const uint8_t *args) {
+	if ((args[0] ? sp_start_break(serial->port) : sp_end_break(serial->port)) != SP_OK)
+		return SP_ERR_FAIL;
+	SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_BREAK, args, 1, utils_time_us());
+	return SP_OK;
+}
+
+static enum sp_return serial_sequence_flush(serial_port_t *serial, const uint8_t *args) {
+	if (args[0] & SERIAL_SEQ_FLUSH_DRAIN) {
+		if (!serial_tx_flush(serial))
+			return SP_ERR_FAIL;
+		uint64_t start	   = utils_time_us();
+		enum sp_return ret = sp_drain(serial->port);
+		SERIAL_STATS_ADD(serial, drain_blocked_us, utils_time_us() - start);
+		if (ret != SP_OK)
+			return ret;
+	}
+	int buffers = 0;
+	if (args[0] & SERIAL_SEQ_FLUSH_RX)
+		buffers |= SP_BUF_INPUT;
+	if (args[0] & SERIAL_SEQ_FLUSH_TX)
+		buffers |= SP_BUF_OUTPUT;
+	if (buffers != 0)
+		return sp_flush(serial->port, buffers);
+	return SP_OK;
+}
+
+static enum sp_return serial_sequence_config(serial_port_t *serial, const uint8_t *args) {
+	// only the line settings change, the rest stays as the page set it
+	serial_config_t config = serial->config;
+	memcpy(&config.baudrate, args, sizeof(config.baudrate));
+	config.data_bits	= args[4];
+	config.parity		= args[5];
+	config.stop_bits	= args[6];
+	config.flow_control = -1;
+	uint8_t applied;
+	enum sp_return ret = serial_set_config(serial, &config, &applied);
+	if (ret == SP_OK)
+		SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_CONFIG, args, 7, utils_time_us());
+	return ret;
+}
+
+enum sp_return serial_sequence_run(
+	serial_port_t *serial,
+	const uint8_t *steps,
+	uint32_t len,
+	uint32_t *timings,
+	uint8_t *count
+) {
+	// argument lengths of each step type
+	static const uint8_t args_len[] = {
+		[SERIAL_SEQ_SIGNALS] = 2,
+		[SERIAL_SEQ_BREAK]	 = 1,
+		[SERIAL_SEQ_DELAY]	 = sizeof(uint32_t),
+		[SERIAL_SEQ_FLUSH]	 = 1,
+		[SERIAL_SEQ_CONFIG]	 = sizeof(uint32_t) + 3,
+	};
+
+	// check the whole sequence first, so that it doesn't stop halfway
+	uint32_t pos	   = 0;
+	uint64_t delays_us = 0;
+	uint8_t drains	   = 0;
+	for (*count = 0; pos < len; (*count)++) {
+		uint8_t type = steps[pos];
+		if (*count == SERIAL_SEQ_STEPS_MAX || type > SERIAL_SEQ_CONFIG || len - pos - 1 < args_len[type])
+			return SP_ERR_ARG;
+		if (type == SERIAL_SEQ_DELAY) {
+			uint32_t delay_us;
+			memcpy(&delay_us, steps + pos + 1, sizeof(delay_us));
+			delays_us += delay_us;
+		}
+		if (type == SERIAL_SEQ_FLUSH && (steps[pos + 1] & SERIAL_SEQ_FLUSH_DRAIN))
+			drains++;
+		pos += 1 + args_len[type];
+	}
+	// too long to finish before the page gives up on it
+	if (delays_us > SERIAL_SEQ_DELAYS_MAX_US || drains > 1)
+		return SP_ERR_ARG;
+
+	// delays end at a planned time, so that oversleeping doesn't add up over more delays
+	uint64_t start = utils_time_us();
+	uint64_t next  = start;
+	pos			   = 0;
+	for (*count = 0; pos < len; (*count)++) {
+		uint8_t type		= steps[pos];
+		const uint8_t *args = steps + pos + 1;
+		enum sp_return ret	= SP_OK;
+		pos += 1 + args_len[type];
+		switch (type) {
+			case SERIAL_SEQ_SIGNALS:
+				ret = serial_sequence_signals(serial, args);
+				break;
+
+			case SERIAL_SEQ_BREAK:
+				ret = serial_sequence_break(serial, args);
+				break;
+
+			case SERIAL_SEQ_DELAY: {
+				uint32_t delay_us;
+				memcpy(&delay_us, args, sizeof(delay_us));
+				next += delay_us;
+				serial_sequence_sleep(next);
+				break;
+			}
+
+			case SERIAL_SEQ_FLUSH:
+				ret = serial_sequence_flush(serial, args);
+				break;
+
+			case SERIAL_SEQ_CONFIG:
+				ret = serial_sequence_config(serial, args);
+				break;
+		}
+		if (ret != SP_OK)
+			return ret;
+		// when the step was done, as measured
+		uint64_t now	= utils_time_us();
+		timings[*count] = now - start;
+		// the next delay starts once the port has done its part
+		if (type != SERIAL_SEQ_DELAY)
+			next = now;
+	}
+	return SP_OK;
+}
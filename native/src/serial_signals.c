@@ -0,0 +1,145 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+static void serial_signals_send(serial_port_t *serial, uint8_t signals, const uint32_t *counts) {
+	// unsolicited, like the RX data - the opcode, the state and the transition counts
+	uint8_t frame[2 + SERIAL_SIGNALS_COUNT * sizeof(uint32_t)];
+	frame[0] = WSM_SIGNALS_CHANGED;
+	frame[1] = signals;
+	memcpy(frame + 2, counts, SERIAL_SIGNALS_COUNT * sizeof(uint32_t));
+	// read once, the port may be detached meanwhile
+	ws_cli_conn_t *conn = serial->conn;
+	if (conn != NULL)
+		ws_sendframe_bin(conn, (const char *)frame, sizeof(frame));
+}
+
+static bool serial_signals_stopping(serial_signals_t *watch) {
+	pthread_mutex_lock(&watch->mutex);
+	bool stop = watch->stop;
+	pthread_mutex_unlock(&watch->mutex);
+	return stop;
+}
+
+static bool serial_signals_wait(serial_port_t *serial, bool *driver, const uint32_t *seen) {
+	serial_signals_t *watch = &serial->signals;
+	if (*driver) {
+		// a change right before the wait would otherwise only be noticed along with the next one
+		uint32_t counts[SERIAL_SIGNALS_COUNT];
+		if (serial_port_get_signal_counts(serial, counts) && memcmp(counts, seen, sizeof(counts)) != 0)
+			return !serial_signals_stopping(watch);
+		if (serial_port_wait_signals(serial, watch->mask))
+			return !serial_signals_stopping(watch);
+		// the driver can't wait for changes - check every now and then instead
+		*driver = false;
+	}
+	pthread_mutex_lock(&watch->mutex);
+	if (!watch->stop)
+		utils_cond_wait_us(&watch->cond, &watch->mutex, SERIAL_SIGNALS_POLL_MS * 1000);
+	bool ret = !watch->stop;
+	pthread_mutex_unlock(&watch->mutex);
+	return ret;
+}
+
+static void *serial_signals_thread(void *arg) {
+	serial_port_t *serial	= arg;
+	serial_signals_t *watch = &serial->signals;
+	uint8_t mask			= watch->mask;
+	// the driver counts the transitions since the port was opened, even the ones too short to see
+	bool driver							= serial_port_get_signal_counts != NULL && serial_port_wait_signals != NULL;
+	uint32_t base[SERIAL_SIGNALS_COUNT] = {0};
+	if (driver && !serial_port_get_signal_counts(serial, base))
+		driver = false;
+	uint32_t seen[SERIAL_SIGNALS_COUNT];
+	memcpy(seen, base, sizeof(seen));
+
+	enum sp_signal state;
+	if (sp_get_signals(serial->port, &state) != SP_OK)
+		goto end;
+	uint8_t last							   = state;
+	uint8_t sent							   = state & mask;
+	uint32_t counts[SERIAL_SIGNALS_COUNT]	   = {0};
+	uint32_t sent_counts[SERIAL_SIGNALS_COUNT] = {0};
+	// the page starts from the current state
+	serial_signals_send(serial, sent, counts);
+
+	while (serial_signals_wait(serial, &driver, seen)) {
+		if (sp_get_signals(serial->port, &state) != SP_OK)
+			break;
+		if (driver && serial_port_get_signal_counts(serial, seen)) {
+			for (int i = 0; i < SERIAL_SIGNALS_COUNT; i++) {
+				counts[i] = seen[i] - base[i];
+			}
+		} else {
+			// only the changes seen between the checks can be counted
+			for (int i = 0; i < SERIAL_SIGNALS_COUNT; i++) {
+				if ((state ^ last) & (1 << i))
+					counts[i]++;
+			}
+		}
+		last = state;
+
+		bool changed = (state & mask) != sent;
+		for (int i = 0; i < SERIAL_SIGNALS_COUNT; i++) {
+			if ((mask & (1 << i)) && counts[i] != sent_counts[i])
+				changed = true;
+		}
+		if (!changed)
+			continue;
+		sent = state & mask;
+		memcpy(sent_counts, counts, sizeof(counts));
+		serial_signals_send(serial, sent, counts);
+	}
+
+end:
+	atomic_store(&watch->running, false);
+	return NULL;
+}
+
+void serial_signals_init(serial_port_t *serial) {
+	serial_signals_t *watch = &serial->signals;
+	watch->mask				= 0;
+	watch->stop				= false;
+	watch->thread			= 0;
+	atomic_init(&watch->running, false);
+	pthread_mutex_init(&watch->mutex, NULL);
+	pthread_cond_init(&watch->cond, NULL);
+}
+
+bool serial_signals_watch(serial_port_t *serial, uint8_t mask) {
+	serial_signals_t *watch = &serial->signals;
+	// started again with the new mask
+	serial_signals_stop(serial);
+	mask &= SP_SIG_CTS | SP_SIG_DSR | SP_SIG_DCD | SP_SIG_RI;
+	if (mask == 0)
+		return true;
+	watch->mask = mask;
+	watch->stop = false;
+	atomic_store(&watch->running, true);
+	if (!utils_thread_create(&watch->thread, serial_signals_thread, serial)) {
+		atomic_store(&watch->running, false);
+		watch->thread = 0;
+		watch->mask	  = 0;
+		return false;
+	}
+	return true;
+}
+
+void serial_signals_stop(serial_port_t *serial) {
+	serial_signals_t *watch = &serial->signals;
+	if (watch->thread == 0)
+		return;
+	pthread_mutex_lock(&watch->mutex);
+	watch->stop = true;
+	pthread_cond_broadcast(&watch->cond);
+	pthread_mutex_unlock(&watch->mutex);
+	// the driver's wait has no timeout, it can only be interrupted (possibly before it started)
+	while (atomic_load(&watch->running)) {
+		if (serial_port_wake_signals != NULL)
+			serial_port_wake_signals(watch->thread);
+		usleep(1000);
+	}
+	pthread_join(watch->thread, NULL);
+	watch->thread = 0;
+	watch->mask	  = 0;
+}
@@ -0,0 +1,56 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+#define STATS_LOAD(serial, field) atomic_load_explicit(&(serial)->stats.field, memory_order_relaxed)
+
+void serial_stats_read(serial_port_t *serial, int len) {
+	// bucket N holds the sizes of N significant bits, i.e. [2^(N-1), 2^N)
+	int bucket = len > 0 ? 32 - __builtin_clz(len) : 0;
+	if (bucket >= SERIAL_STATS_READ_BUCKETS)
+		bucket = SERIAL_STATS_READ_BUCKETS - 1;
+	SERIAL_STATS_ADD(serial, read_sizes[bucket], 1);
+	if (len > 0)
+		SERIAL_STATS_ADD(serial, rx_bytes, len);
+}
+
+void serial_stats_error(serial_port_t *serial, uint8_t opcode) {
+	if (opcode < SERIAL_STATS_OPCODES)
+		SERIAL_STATS_ADD(serial, errors[opcode], 1);
+}
+
+void serial_stats_write(json_writer_t *writer, serial_port_t *serial) {
+	json_add_string(writer, "port", serial->port_name);
+	json_add_bool(writer, "open", serial->port != NULL);
+	json_add_int(writer, "rxBytes", STATS_LOAD(serial, rx_bytes));
+	json_add_int(writer, "rxFrames", STATS_LOAD(serial, rx_frames));
+	json_add_int(writer, "rxFramesCut", STATS_LOAD(serial, rx_frames_cut));
+	json_add_int(writer, "subscribers", atomic_load(&serial->subscribers.len));
+	json_add_int(writer, "subscribersDropped", STATS_LOAD(serial, subscribers_dropped));
+	json_add_int(writer, "txBytes", STATS_LOAD(serial, tx_bytes));
+	json_add_int(writer, "txFrames", STATS_LOAD(serial, tx_frames));
+	json_array_begin(writer, "readSizes");
+	for (int i = 0; i < SERIAL_STATS_READ_BUCKETS; i++) {
+		json_add_int(writer, NULL, STATS_LOAD(serial, read_sizes[i]));
+	}
+	json_array_end(writer);
+	json_add_int(writer, "waitWakeups", STATS_LOAD(serial, wait_wakeups));
+	json_add_int(writer, "waitTimeouts", STATS_LOAD(serial, wait_timeouts));
+	json_add_int(writer, "writeBlockedUs", STATS_LOAD(serial, write_blocked_us));
+	json_add_int(writer, "drainBlockedUs", STATS_LOAD(serial, drain_blocked_us));
+	json_add_int(writer, "openUs", STATS_LOAD(serial, open_us));
+	json_add_int(writer, "closeUs", STATS_LOAD(serial, close_us));
+	json_add_int(writer, "rxRingSize", serial->rx.size);
+	json_add_int(writer, "rxRingHighWater", STATS_LOAD(serial, rx_ring_high));
+	// only the opcodes that failed at least once
+	json_object_begin(writer, "errors");
+	for (int i = 0; i < SERIAL_STATS_OPCODES; i++) {
+		uint32_t errors = STATS_LOAD(serial, errors[i]);
+		if (errors == 0)
+			continue;
+		char opcode[4];
+		snprintf(opcode, sizeof(opcode), "%d", i);
+		json_add_int(writer, opcode, errors);
+	}
+	json_object_end(writer);
+}
@@ -0,0 +1,202 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+static inline uint32_t serial_subscriber_tail(serial_subscriber_t *sub) {
+	return (sub->head + SERIAL_SUBSCRIBER_FRAMES - sub->len) % SERIAL_SUBSCRIBER_FRAMES;
+}
+
+static void serial_subscriber_frame_put(serial_subscriber_frame_t *frame) {
+	if (atomic_fetch_sub(&frame->refs, 1) == 1)
+		free(frame);
+}
+
+static void *serial_subscriber_thread(void *arg) {
+	serial_subscriber_t *sub = arg;
+
+	pthread_mutex_lock(&sub->mutex);
+	while (1) {
+		if (!sub->stop && sub->len == 0) {
+			pthread_cond_wait(&sub->cond, &sub->mutex);
+			continue;
+		}
+		if (sub->stop)
+			break;
+		serial_subscriber_frame_t *frame = sub->frames[serial_subscriber_tail(sub)];
+		sub->sending					 = true;
+		pthread_mutex_unlock(&sub->mutex);
+		// may block for as long as the page doesn't read - only this subscriber waits for it
+		bool sent = ws_sendframe_bin(sub->conn, (const char *)frame->data, frame->len) >= 0;
+		pthread_mutex_lock(&sub->mutex);
+		sub->sending = false;
+		sub->failed |= !sent;
+		sub->len--;
+		sub->queued -= frame->len;
+		serial_subscriber_frame_put(frame);
+		pthread_cond_broadcast(&sub->cond);
+	}
+
+	// whatever wasn't sent yet is dropped
+	for (; sub->len != 0; sub->len--) {
+		serial_subscriber_frame_put(sub->frames[serial_subscriber_tail(sub)]);
+	}
+	bool close = sub->close;
+	pthread_mutex_unlock(&sub->mutex);
+	if (close) {
+		ws_close_client(sub->conn);
+		// the connection can go away now - let its serial_unsubscribe() return
+		serial_subscribers_t *subscribers = &sub->serial->subscribers;
+		serial_unlink_subscriber(sub);
+		pthread_mutex_lock(&subscribers->mutex);
+		pthread_cond_broadcast(&subscribers->cond);
+		pthread_mutex_unlock(&subscribers->mutex);
+	}
+	pthread_cond_destroy(&sub->cond);
+	pthread_mutex_destroy(&sub->mutex);
+	free(sub);
+	return NULL;
+}
+
+static bool serial_subscriber_push(serial_subscriber_t *sub, serial_subscriber_frame_t *frame) {
+	pthread_mutex_lock(&sub->mutex);
+	// a frame bigger than the queue still goes through, as long as nothing else is waiting
+	bool ret = !sub->failed && sub->len < SERIAL_SUBSCRIBER_FRAMES &&
+			   (sub->len == 0 || sub->queued + frame->len <= SERIAL_SUBSCRIBER_QUEUE_SIZE);
+	if (ret) {
+		atomic_fetch_add(&frame->refs, 1);
+		sub->frames[sub->head] = frame;
+		sub->head			   = (sub->head + 1) % SERIAL_SUBSCRIBER_FRAMES;
+		sub->len++;
+		sub->queued += frame->len;
+		pthread_cond_broadcast(&sub->cond);
+	}
+	pthread_mutex_unlock(&sub->mutex);
+	return ret;
+}
+
+static void serial_subscriber_stop(serial_subscriber_t *sub, bool close, bool wait) {
+	// nothing can find it anymore, the sender thread frees it once it finishes;
+	// one that closes the connection stays findable until then, so that the connection outlives it
+	if (!close)
+		serial_unlink_subscriber(sub);
+	pthread_mutex_lock(&sub->mutex);
+	sub->stop  = true;
+	sub->close = close;
+	pthread_cond_broadcast(&sub->cond);
+	// the connection may be reused once it's gone - make sure nothing is being sent to it then
+	while (wait && sub->sending) {
+		pthread_cond_wait(&sub->cond, &sub->mutex);
+	}
+	pthread_mutex_unlock(&sub->mutex);
+}
+
+bool serial_subscribe(serial_port_t *serial, ws_cli_conn_t *conn) {
+	serial_subscribers_t *subscribers = &serial->subscribers;
+	serial_subscriber_t *sub		  = calloc(1, sizeof(*sub));
+	if (sub == NULL)
+		return false;
+	sub->serial = serial;
+	sub->conn	= conn;
+	pthread_mutex_init(&sub->mutex, NULL);
+	pthread_cond_init(&sub->cond, NULL);
+	pthread_t thread;
+	if (!utils_thread_create(&thread, serial_subscriber_thread, sub)) {
+		pthread_cond_destroy(&sub->cond);
+		pthread_mutex_destroy(&sub->mutex);
+		free(sub);
+		return false;
+	}
+	pthread_detach(thread);
+	// findable before the RX sender can drop it, so that dropping always unlinks it
+	serial_link_subscriber(sub);
+
+	pthread_mutex_lock(&subscribers->mutex);
+	uint8_t len = atomic_load(&subscribers->len);
+	// checked here, the owner might be closing the port right now
+	bool ret = subscribers->shared && len < SERIAL_SUBSCRIBERS_MAX;
+	if (ret) {
+		subscribers->subs[len] = sub;
+		atomic_store(&subscribers->len, len + 1);
+	}
+	pthread_mutex_unlock(&subscribers->mutex);
+	if (!ret)
+		serial_subscriber_stop(sub, false, false);
+	return ret;
+}
+
+serial_port_t *serial_unsubscribe(ws_cli_conn_t *conn) {
+	serial_port_t *serial = serial_get_by_subscriber(conn);
+	if (serial == NULL)
+		return NULL;
+	serial_subscribers_t *subscribers = &serial->subscribers;
+	serial_subscriber_t *sub		  = NULL;
+	// whoever takes it out of the list stops it
+	pthread_mutex_lock(&subscribers->mutex);
+	uint8_t len = atomic_load(&subscribers->len);
+	for (int i = 0; i < len; i++) {
+		if (subscribers->subs[i]->conn == conn) {
+			sub = subscribers->subs[i];
+			// the order doesn't matter
+			subscribers->subs[i] = subscribers->subs[len - 1];
+			atomic_store(&subscribers->len, len - 1);
+			break;
+		}
+	}
+	// already dropped - wait until its sender thread is done with the connection
+	while (sub == NULL && serial_get_by_subscriber(conn) != NULL) {
+		pthread_cond_wait(&subscribers->cond, &subscribers->mutex);
+	}
+	pthread_mutex_unlock(&subscribers->mutex);
+	if (sub == NULL)
+		return NULL;
+	serial_subscriber_stop(sub, false, true);
+	return serial;
+}
+
+void serial_unsubscribe_all(serial_port_t *serial) {
+	serial_subscribers_t *subscribers = &serial->subscribers;
+	serial_subscriber_t *subs[SERIAL_SUBSCRIBERS_MAX];
+	pthread_mutex_lock(&subscribers->mutex);
+	uint8_t len = atomic_load(&subscribers->len);
+	memcpy(subs, subscribers->subs, len * sizeof(*subs));
+	atomic_store(&subscribers->len, 0);
+	subscribers->shared = false;
+	pthread_mutex_unlock(&subscribers->mutex);
+	// nothing will be sent to them anymore; their connections are closed once the sends in flight finish
+	for (int i = 0; i < len; i++) {
+		serial_subscriber_stop(subs[i], true, false);
+	}
+}
+
+void serial_subscribers_send(serial_port_t *serial, const uint8_t *frame, uint32_t len) {
+	serial_subscribers_t *subscribers = &serial->subscribers;
+	// a single copy for all of them, as the ring is reused once the owner got it
+	serial_subscriber_frame_t *copy = malloc(sizeof(*copy) + len);
+	if (copy == NULL)
+		return;
+	atomic_init(&copy->refs, 1);
+	copy->len = len;
+	memcpy(copy->data, frame, len);
+
+	serial_subscriber_t *dropped[SERIAL_SUBSCRIBERS_MAX];
+	int dropped_len = 0;
+	pthread_mutex_lock(&subscribers->mutex);
+	for (int i = 0; i < subscribers->len;) {
+		if (serial_subscriber_push(subscribers->subs[i], copy)) {
+			i++;
+			continue;
+		}
+		// gone, or too far behind - drop it instead of letting the queue grow
+		uint8_t last		   = subscribers->len - 1;
+		dropped[dropped_len++] = subscribers->subs[i];
+		subscribers->subs[i]   = subscribers->subs[last];
+		atomic_store(&subscribers->len, last);
+	}
+	pthread_mutex_unlock(&subscribers->mutex);
+	serial_subscriber_frame_put(copy);
+
+	for (int i = 0; i < dropped_len; i++) {
+		SERIAL_STATS_ADD(serial, subscribers_dropped, 1);
+		serial_subscriber_stop(dropped[i], true, false);
+	}
+}
@@ -0,0 +1,175 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "serial.h"
+
+static void *serial_tx_thread(void *arg) {
+	serial_port_t *serial = arg;
+	serial_tx_t *tx		  = &serial->tx;
+
+	pthread_mutex_lock(&tx->mutex);
+	while (!tx->stop) {
+		if (tx->len == 0) {
+			pthread_cond_wait(&tx->cond, &tx->mutex);
+			continue;
+		}
+
+		// write the oldest contiguous part of the queue;
+		// the page only enqueues into the free space, so it's safe to do unlocked
+		uint32_t tail  = (tx->head + SERIAL_TX_QUEUE_SIZE - tx->len) % SERIAL_TX_QUEUE_SIZE;
+		uint32_t chunk = tx->len;
+		if (chunk > SERIAL_TX_QUEUE_SIZE - tail)
+			chunk = SERIAL_TX_QUEUE_SIZE - tail;
+		pthread_mutex_unlock(&tx->mutex);
+		uint64_t start = utils_time_us();
+		int written	   = sp_blocking_write(serial->port, tx->buf + tail, chunk, SERIAL_TX_TIMEOUT_MS);
+		SERIAL_STATS_ADD(serial, write_blocked_us, utils_time_us() - start);
+		char *error = NULL;
+		if (written < 0) {
+			char *error_msg = sp_last_error_message();
+			error			= strdup(error_msg != NULL ? error_msg : "Write failed");
+			sp_free_error_message(error_msg);
+		}
+		pthread_mutex_lock(&tx->mutex);
+
+		if (written < 0) {
+			// drop the queued data, report the error to the page
+			free(tx->error);
+			tx->error = error;
+			tx->len	  = 0;
+		} else {
+			tx->len -= written;
+			SERIAL_STATS_ADD(serial, tx_bytes, written);
+		}
+		pthread_cond_broadcast(&tx->cond);
+	}
+	pthread_mutex_unlock(&tx->mutex);
+	return NULL;
+}
+
+bool serial_tx_start(serial_port_t *serial) {
+	serial_tx_t *tx = &serial->tx;
+	// released by serial_tx_stop(), like the RX buffer
+	if (tx->buf == NULL && (tx->buf = malloc(SERIAL_TX_QUEUE_SIZE)) == NULL)
+		return false;
+	tx->head  = 0;
+	tx->len	  = 0;
+	tx->limit = SERIAL_TX_QUEUE_MIN;
+	tx->error = NULL;
+	tx->stop  = false;
+	pthread_mutex_init(&tx->mutex, NULL);
+	pthread_cond_init(&tx->cond, NULL);
+	if (!utils_thread_create(&tx->thread, serial_tx_thread, serial)) {
+		tx->thread = 0;
+		pthread_cond_destroy(&tx->cond);
+		pthread_mutex_destroy(&tx->mutex);
+		return false;
+	}
+	return true;
+}
+
+void serial_tx_stop(serial_port_t *serial) {
+	serial_tx_t *tx = &serial->tx;
+	if (tx->thread == 0)
+		return;
+	pthread_mutex_lock(&tx->mutex);
+	tx->stop = true;
+	pthread_cond_broadcast(&tx->cond);
+	pthread_mutex_unlock(&tx->mutex);
+	// returns within SERIAL_TX_TIMEOUT_MS, even if the write is stuck
+	pthread_join(tx->thread, NULL);
+	tx->thread = 0;
+	free(tx->error);
+	free(tx->buf);
+	tx->error = NULL;
+	tx->buf	  = NULL;
+	pthread_cond_destroy(&tx->cond);
+	pthread_mutex_destroy(&tx->mutex);
+}
+
+void serial_tx_set_baudrate(serial_port_t *serial, uint32_t baudrate) {
+	// ~10 bits per character on the wire
+	uint64_t limit = (uint64_t)baudrate / 10 * SERIAL_TX_QUEUE_MS / 1000;
+	serial_tx_set_limit(serial, limit > SERIAL_TX_QUEUE_SIZE ? SERIAL_TX_QUEUE_SIZE : limit);
+}
+
+void serial_tx_set_limit(serial_port_t *serial, uint32_t limit) {
+	serial_tx_t *tx = &serial->tx;
+	if (limit < SERIAL_TX_QUEUE_MIN)
+		limit = SERIAL_TX_QUEUE_MIN;
+	if (limit > SERIAL_TX_QUEUE_SIZE)
+		limit = SERIAL_TX_QUEUE_SIZE;
+	pthread_mutex_lock(&tx->mutex);
+	tx->limit = limit;
+	pthread_cond_broadcast(&tx->cond);
+	pthread_mutex_unlock(&tx->mutex);
+}
+
+static bool serial_tx_wait(serial_tx_t *tx, uint64_t deadline) {
+	uint64_t now = utils_time_us();
+	if (now < deadline) {
+		utils_cond_wait_us(&tx->cond, &tx->mutex, deadline - now);
+		return true;
+	}
+	// the line is stalled (e.g. by flow control) - the page's connection can't wait for it forever;
+	// the queued data stays, in case the line comes back
+	tx->error = strdup("Write timed out");
+	return false;
+}
+
+bool serial_tx_enqueue(serial_port_t *serial, const uint8_t *data, uint32_t len) {
+	serial_tx_t *tx	  = &serial->tx;
+	uint64_t deadline = utils_time_us() + SERIAL_TX_WAIT_MS * 1000ull;
+	bool ret		  = true;
+	pthread_mutex_lock(&tx->mutex);
+	while (ret && len != 0 && tx->error == NULL && !tx->stop) {
+		// the page went over its credits - wait until there's some room
+		if (tx->len >= tx->limit) {
+			ret = serial_tx_wait(tx, deadline);
+			continue;
+		}
+		uint32_t chunk = tx->limit - tx->len;
+		if (chunk > len)
+			chunk = len;
+		if (chunk > SERIAL_TX_QUEUE_SIZE - tx->head)
+			chunk = SERIAL_TX_QUEUE_SIZE - tx->head;
+		memcpy(tx->buf + tx->head, data, chunk);
+		tx->head = (tx->head + chunk) % SERIAL_TX_QUEUE_SIZE;
+		tx->len += chunk;
+		data += chunk;
+		len -= chunk;
+		pthread_cond_broadcast(&tx->cond);
+	}
+	ret &= tx->error == NULL;
+	pthread_mutex_unlock(&tx->mutex);
+	return ret;
+}
+
+bool serial_tx_flush(serial_port_t *serial) {
+	serial_tx_t *tx	  = &serial->tx;
+	uint64_t deadline = utils_time_us() + SERIAL_TX_WAIT_MS * 1000ull;
+	bool ret		  = true;
+	pthread_mutex_lock(&tx->mutex);
+	while (ret && tx->len != 0 && tx->error == NULL && !tx->stop) {
+		ret = serial_tx_wait(tx, deadline);
+	}
+	ret &= tx->error == NULL;
+	pthread_mutex_unlock(&tx->mutex);
+	return ret;
+}
+
+char *serial_tx_get_error(serial_port_t *serial) {
+	serial_tx_t *tx = &serial->tx;
+	pthread_mutex_lock(&tx->mutex);
+	char *error = tx->error;
+	tx->error	= NULL;
+	pthread_mutex_unlock(&tx->mutex);
+	return error;
+}
+
+uint32_t serial_tx_get_credits(serial_port_t *serial) {
+	serial_tx_t *tx = &serial->tx;
+	pthread_mutex_lock(&tx->mutex);
+	uint32_t credits = tx->len < tx->limit ? tx->limit - tx->len : 0;
+	pthread_mutex_unlock(&tx->mutex);
+	return credits;
+}
@@ -75,4 +75,37 @@ void serial_port_fix_details(struct sp_port *port, const char *id) {
 	}
 }
 
+bool serial_port_add_wake(serial_port_t *serial) {
+	struct sp_event_set *event_set = serial->event_set;
+	// manual-reset, so that every later sp_wait() returns too once it's set
+	HANDLE event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (event == NULL)
+		return false;
+
+	// appended the way sp_add_port_events() does it, so that sp_free_event_set() frees it along
+	event_handle *handles = realloc(event_set->handles, (event_set->count + 1) * sizeof(event_handle));
+	if (handles != NULL)
+		event_set->handles = handles;
+	enum sp_event *masks = realloc(event_set->masks, (event_set->count + 1) * sizeof(enum sp_event));
+	if (masks != NULL)
+		event_set->masks = masks;
+	if (handles == NULL || masks == NULL) {
+		CloseHandle(event);
+		return false;
+	}
+	handles[event_set->count] = event;
+	masks[event_set->count]	  = SP_EVENT_RX_READY;
+	event_set->count++;
+	serial->wake = event;
+	return true;
+}
+
+void serial_port_wake(serial_port_t *serial) {
+	SetEvent(serial->wake);
+}
+
+void serial_port_free_wake(serial_port_t *serial) {
+	CloseHandle(serial->wake);
+}
+
 #endif
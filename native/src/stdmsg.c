@@ -2,108 +2,266 @@
 
 #include "stdmsg.h"
 
-static void stdmsg_write(cJSON *message) {
-	char *json = cJSON_PrintUnformatted(message);
-	if (json == NULL)
+#include <errno.h>
+
+// protects stdout, used by the writer thread and for messages that don't fit in the ring
+static pthread_mutex_t stdmsg_mutex = PTHREAD_MUTEX_INITIALIZER;
+// messages waiting for the writer thread
+static ring_t stdmsg_ring;
+static pthread_t stdmsg_thread = 0;
+static bool stdmsg_running	   = false;
+// used to wake up the writer thread when it's idle
+static pthread_mutex_t stdmsg_wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stdmsg_wake_cond	 = PTHREAD_COND_INITIALIZER;
+static _Atomic bool stdmsg_idle			 = false;
+static bool stdmsg_stop					 = false;
+// logs that were dropped, because the ring was full
+static _Atomic uint32_t stdmsg_dropped = 0;
+static _Atomic int stdmsg_level		   = STDMSG_INFO;
+// queue of messages waiting for a worker thread
+static pthread_mutex_t stdmsg_jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stdmsg_jobs_cond	 = PTHREAD_COND_INITIALIZER;
+static cJSON *stdmsg_jobs[STDMSG_JOBS_SIZE];
+static int stdmsg_jobs_head	 = 0;
+static int stdmsg_jobs_len	 = 0;
+static bool stdmsg_jobs_stop = false;
+static pthread_t stdmsg_workers[STDMSG_WORKERS];
+static int stdmsg_workers_len = 0;
+
+static void *stdmsg_worker(void *arg);
+
+static void *stdmsg_writer(void *arg) {
+	pthread_mutex_lock(&stdmsg_wake_mutex);
+	while (1) {
+		uint32_t len;
+		const void *data = ring_peek(&stdmsg_ring, &len);
+		if (data == NULL) {
+			if (stdmsg_stop)
+				break;
+			atomic_store(&stdmsg_idle, true);
+			// check again, a producer might have not seen the flag yet
+			atomic_thread_fence(memory_order_seq_cst);
+			if (ring_peek(&stdmsg_ring, &len) == NULL && !stdmsg_stop)
+				pthread_cond_wait(&stdmsg_wake_cond, &stdmsg_wake_mutex);
+			atomic_store(&stdmsg_idle, false);
+			continue;
+		}
+		pthread_mutex_unlock(&stdmsg_wake_mutex);
+
+		// write everything that's queued with a single flush
+		pthread_mutex_lock(&stdmsg_mutex);
+		while ((data = ring_peek(&stdmsg_ring, &len)) != NULL) {
+			fwrite(data, sizeof(char), len, stdout);
+			ring_pop(&stdmsg_ring);
+		}
+		fflush(stdout);
+		pthread_mutex_unlock(&stdmsg_mutex);
+
+		pthread_mutex_lock(&stdmsg_wake_mutex);
+	}
+	pthread_mutex_unlock(&stdmsg_wake_mutex);
+	return NULL;
+}
+
+void stdmsg_start() {
+	// without workers, all actions run on the main thread
+	for (int i = 0; i < STDMSG_WORKERS; i++) {
+		if (!utils_thread_create(&stdmsg_workers[stdmsg_workers_len], stdmsg_worker, NULL))
+			break;
+		stdmsg_workers_len++;
+	}
+
+	// let the writer thread batch the messages into one write()
+	setvbuf(stdout, NULL, _IOFBF, STDMSG_BATCH_SIZE);
+	if (!ring_init(&stdmsg_ring, STDMSG_RING_SLOTS, STDMSG_SLOT_SIZE))
+		return;
+	if (!utils_thread_create(&stdmsg_thread, stdmsg_writer, NULL)) {
+		ring_free(&stdmsg_ring);
+		return;
+	}
+	stdmsg_running = true;
+}
+
+void stdmsg_flush() {
+	// let the workers finish the queued actions
+	pthread_mutex_lock(&stdmsg_jobs_mutex);
+	stdmsg_jobs_stop = true;
+	pthread_cond_broadcast(&stdmsg_jobs_cond);
+	pthread_mutex_unlock(&stdmsg_jobs_mutex);
+	for (int i = 0; i < stdmsg_workers_len; i++) {
+		pthread_join(stdmsg_workers[i], NULL);
+	}
+	stdmsg_workers_len = 0;
+
+	if (!stdmsg_running)
 		return;
-	uint32_t len = strlen(json);
-	fwrite(&len, sizeof(uint32_t), 1, stdout);
-	fwrite(json, sizeof(char), len, stdout);
+	// the writer thread finishes once the ring is empty
+	pthread_mutex_lock(&stdmsg_wake_mutex);
+	stdmsg_stop = true;
+	pthread_cond_signal(&stdmsg_wake_cond);
+	pthread_mutex_unlock(&stdmsg_wake_mutex);
+	pthread_join(stdmsg_thread, NULL);
+	stdmsg_running = false;
+
+	// write whatever was queued in the meantime
+	uint32_t len;
+	const void *data;
+	pthread_mutex_lock(&stdmsg_mutex);
+	while ((data = ring_peek(&stdmsg_ring, &len)) != NULL) {
+		fwrite(data, sizeof(char), len, stdout);
+		ring_pop(&stdmsg_ring);
+	}
 	fflush(stdout);
-	free(json);
+	pthread_mutex_unlock(&stdmsg_mutex);
+}
+
+static bool stdmsg_write(json_writer_t *writer, bool is_log) {
+	uint32_t len = json_writer_end(writer);
+	if (len == 0)
+		return false;
+
+	if (stdmsg_running) {
+		if (ring_push(&stdmsg_ring, writer->buf, len)) {
+			atomic_thread_fence(memory_order_seq_cst);
+			if (atomic_load(&stdmsg_idle)) {
+				pthread_mutex_lock(&stdmsg_wake_mutex);
+				pthread_cond_signal(&stdmsg_wake_cond);
+				pthread_mutex_unlock(&stdmsg_wake_mutex);
+			}
+			return true;
+		}
+		// never wait for stdout just to log something
+		if (is_log) {
+			atomic_fetch_add(&stdmsg_dropped, 1);
+			return false;
+		}
+	}
+
+	// too big for a slot, the ring is full, or there's no writer thread
+	pthread_mutex_lock(&stdmsg_mutex);
+	fwrite(writer->buf, sizeof(char), len, stdout);
+	fflush(stdout);
+	pthread_mutex_unlock(&stdmsg_mutex);
+	return true;
+}
+
+void stdmsg_set_log_level(stdmsg_level_t level) {
+	atomic_store(&stdmsg_level, level);
+}
+
+uint32_t stdmsg_get_dropped() {
+	return atomic_load(&stdmsg_dropped);
+}
+
+json_writer_t *stdmsg_begin(const char *id) {
+	json_writer_t *writer = json_writer_begin();
+	if (writer == NULL)
+		return NULL;
+	if (id != NULL)
+		json_add_string(writer, "id", id);
+	return writer;
+}
+
+bool stdmsg_end(json_writer_t *writer) {
+	return stdmsg_write(writer, false);
+}
+
+int stdmsg_send_log_v(stdmsg_level_t level, const char *fmt, va_list argv) {
+	if (level > atomic_load(&stdmsg_level))
+		return 0;
+
+	char data[256];
+	int len = vsnprintf(data, sizeof(data), fmt, argv);
+
+	json_writer_t *writer = stdmsg_begin(NULL);
+	if (writer == NULL)
+		return len;
+	json_add_string(writer, "data", data);
+	stdmsg_write(writer, true);
+	return len;
 }
 
 void stdmsg_send_log(const char *fmt, ...) {
 	va_list argv;
 	va_start(argv, fmt);
-	char data[256];
-	vsnprintf(data, 256, fmt, argv);
+	stdmsg_send_log_v(STDMSG_INFO, fmt, argv);
 	va_end(argv);
+}
 
-	cJSON *message = cJSON_CreateObject();
-	if (message == NULL)
-		goto end;
-	if (cJSON_AddStringToObject(message, "data", data) == NULL)
-		goto end;
-	stdmsg_write(message);
-end:
-	cJSON_Delete(message);
-	return;
+void stdmsg_send_debug(const char *fmt, ...) {
+	va_list argv;
+	va_start(argv, fmt);
+	stdmsg_send_log_v(STDMSG_DEBUG, fmt, argv);
+	va_end(argv);
 }
 
 void stdmsg_send_json(const char *id, cJSON *data) {
-	cJSON *message = cJSON_CreateObject();
-	if (message == NULL)
-		goto end;
-	if (cJSON_AddStringToObject(message, "id", id) == NULL)
-		goto end;
-	if (cJSON_AddItemToObject(message, "data", data) == 0)
+	json_writer_t *writer = stdmsg_begin(id);
+	if (writer == NULL)
 		goto end;
-	stdmsg_write(message);
+	json_add_cjson(writer, "data", data);
+	stdmsg_write(writer, false);
 end:
-	cJSON_Delete(message);
-	return;
+	cJSON_Delete(data);
 }
 
 void stdmsg_send_error(const char *id, int error) {
-	cJSON *message = cJSON_CreateObject();
-	if (message == NULL)
-		goto end;
-	if (id != NULL && cJSON_AddStringToObject(message, "id", id) == NULL)
-		goto end;
-	if (cJSON_AddNumberToObject(message, "error", error) == NULL)
+	json_writer_t *writer = stdmsg_begin(id);
+	if (writer == NULL)
+		return;
+	json_add_int(writer, "error", error);
+	stdmsg_write(writer, false);
+}
+
+void stdmsg_send_event(const char *event, cJSON *data) {
+	json_writer_t *writer = stdmsg_begin(NULL);
+	if (writer == NULL)
 		goto end;
-	stdmsg_write(message);
+	json_add_string(writer, "event", event);
+	json_add_cjson(writer, "data", data);
+	stdmsg_write(writer, false);
 end:
-	cJSON_Delete(message);
-	return;
+	cJSON_Delete(data);
 }
 
-void stdmsg_parse(char *json) {
+static void stdmsg_handle(cJSON *message) {
 	int error		   = 50;
-	const char *action = NULL;
-	const char *id	   = NULL;
-
-	cJSON *message = cJSON_Parse(json);
-	if (message == NULL)
-		goto error;
-	cJSON *j_action = cJSON_GetObjectItem(message, "action");
-	if (j_action == NULL)
-		goto error;
-	cJSON *j_id = cJSON_GetObjectItem(message, "id");
-	if (j_id == NULL)
-		goto error;
-	action = cJSON_GetStringValue(j_action);
-	id	   = cJSON_GetStringValue(j_id);
+	const char *action = cJSON_GetStringValue(cJSON_GetObjectItem(message, "action"));
+	const char *id	   = cJSON_GetStringValue(cJSON_GetObjectItem(message, "id"));
 
 	if (strcmp(action, "ping") == 0) {
-		cJSON *data = cJSON_CreateObject();
-		if (data == NULL) {
+		json_writer_t *writer = stdmsg_begin(id);
+		if (writer == NULL) {
 			error = 70;
 			goto error;
 		}
-		if (cJSON_AddStringToObject(data, "version", NATIVE_VERSION) == NULL) {
+		json_object_begin(writer, "data");
+		json_add_string(writer, "version", NATIVE_VERSION);
+		json_add_int(writer, "protocol", NATIVE_PROTOCOL);
+		json_add_int(writer, "wsPort", WEBSOCKET_PORT);
+		json_add_int(writer, "logsDropped", stdmsg_get_dropped());
+		// lets the page relate timestamps of the RX data to its own clock
+		json_add_int(writer, "timeUs", utils_time_us());
+		json_object_end(writer);
+		if (!stdmsg_end(writer)) {
 			error = 71;
 			goto error;
 		}
-		if (cJSON_AddNumberToObject(data, "protocol", NATIVE_PROTOCOL) == NULL) {
-			error = 72;
-			goto error;
-		}
-		if (cJSON_AddNumberToObject(data, "wsPort", WEBSOCKET_PORT) == NULL) {
-			error = 73;
-			goto error;
-		}
-		stdmsg_send_json(id, data);
 	}
 
 	else if (strcmp(action, "listPorts") == 0) {
-		cJSON *data = serial_list_ports_json();
-		if (data == NULL) {
+		serial_filter_t *filters = NULL;
+		int filters_len			 = 0;
+		if (!serial_filter_parse(cJSON_GetObjectItem(message, "filters"), &filters, &filters_len)) {
+			error = 64;
+			goto error;
+		}
+		bool sent = serial_list_ports_send(id, filters, filters_len);
+		serial_filter_free(filters, filters_len);
+		if (!sent) {
 			error = 60;
 			goto error;
 		}
-		stdmsg_send_json(id, data);
 	}
 
 	else if (strcmp(action, "authGrant") == 0) {
@@ -112,13 +270,14 @@ void stdmsg_parse(char *json) {
 			error = 61;
 			goto error;
 		}
-		const char *auth_key = serial_auth_grant(cJSON_GetStringValue(port));
-		cJSON *data			 = cJSON_CreateStringReference(auth_key);
-		if (data == NULL) {
+		const char *auth_key  = serial_auth_grant(cJSON_GetStringValue(port));
+		json_writer_t *writer = auth_key != NULL ? stdmsg_begin(id) : NULL;
+		if (writer == NULL) {
 			error = 62;
 			goto error;
 		}
-		stdmsg_send_json(id, data);
+		json_add_string(writer, "data", auth_key);
+		stdmsg_end(writer);
 	}
 
 	else if (strcmp(action, "authRevoke") == 0) {
@@ -128,7 +287,95 @@ void stdmsg_parse(char *json) {
 			goto error;
 		}
 		serial_auth_revoke(cJSON_GetStringValue(port));
-		stdmsg_send_json(id, cJSON_CreateNull());
+		json_writer_t *writer = stdmsg_begin(id);
+		if (writer == NULL) {
+			error = 63;
+			goto error;
+		}
+		json_add_null(writer, "data");
+		stdmsg_end(writer);
+	}
+
+	else if (strcmp(action, "setLogLevel") == 0) {
+		cJSON *level = cJSON_GetObjectItem(message, "level");
+		if (!cJSON_IsNumber(level) || level->valueint < STDMSG_ERROR || level->valueint > STDMSG_DEBUG) {
+			error = 65;
+			goto error;
+		}
+		stdmsg_set_log_level(level->valueint);
+		json_writer_t *writer = stdmsg_begin(id);
+		if (writer == NULL) {
+			error = 66;
+			goto error;
+		}
+		json_add_null(writer, "data");
+		stdmsg_end(writer);
+	}
+
+	else if (strcmp(action, "stats") == 0) {
+		if (!serial_stats_send(id)) {
+			error = 67;
+			goto error;
+		}
+	}
+
+	else if (strcmp(action, "captureStart") == 0 || strcmp(action, "captureStop") == 0) {
+		const char *port_name = cJSON_GetStringValue(cJSON_GetObjectItem(message, "port"));
+		serial_port_t *serial = port_name != NULL ? serial_get_by_name(port_name) : NULL;
+		if (serial == NULL) {
+			error = 72;
+			goto error;
+		}
+		if (strcmp(action, "captureStart") == 0) {
+			const char *path = cJSON_GetStringValue(cJSON_GetObjectItem(message, "path"));
+			if (path == NULL || !serial_capture_start(serial, path)) {
+				error = 73;
+				goto error;
+			}
+		} else if (!serial_capture_stop(serial)) {
+			error = 73;
+			goto error;
+		}
+		json_writer_t *writer = stdmsg_begin(id);
+		if (writer == NULL) {
+			error = 74;
+			goto error;
+		}
+		json_add_null(writer, "data");
+		stdmsg_end(writer);
+	}
+
+	else if (strcmp(action, "replayStart") == 0) {
+		const char *path = cJSON_GetStringValue(cJSON_GetObjectItem(message, "path"));
+		cJSON *speed	 = cJSON_GetObjectItem(message, "speed");
+		if (path == NULL || serial_replay_start == NULL) {
+			error = 75;
+			goto error;
+		}
+		// the PTY that plays the capture back; the page opens it like any other port
+		const char *port_name = serial_replay_start(path, cJSON_IsNumber(speed) ? speed->valuedouble : 1.0);
+		json_writer_t *writer = port_name != NULL ? stdmsg_begin(id) : NULL;
+		if (writer == NULL) {
+			error = 76;
+			goto error;
+		}
+		json_add_string(writer, "data", port_name);
+		stdmsg_end(writer);
+	}
+
+	else if (strcmp(action, "replayStop") == 0) {
+		const char *port_name = cJSON_GetStringValue(cJSON_GetObjectItem(message, "port"));
+		if (port_name == NULL || serial_replay_stop == NULL || !serial_replay_stop(port_name)) {
+			error = 77;
+			goto error;
+		}
+		json_writer_t *writer = stdmsg_begin(id);
+		if (writer == NULL) {
+			error = 77;
+			goto error;
+		}
+		json_add_null(writer, "data");
+		stdmsg_end(writer);
 	}
 
 	else {
@@ -143,21 +390,108 @@ end:
 	cJSON_Delete(message);
 }
 
+static void *stdmsg_worker(void *arg) {
+	pthread_mutex_lock(&stdmsg_jobs_mutex);
+	while (1) {
+		if (stdmsg_jobs_len == 0) {
+			if (stdmsg_jobs_stop)
+				break;
+			pthread_cond_wait(&stdmsg_jobs_cond, &stdmsg_jobs_mutex);
+			continue;
+		}
+		cJSON *message	 = stdmsg_jobs[stdmsg_jobs_head];
+		stdmsg_jobs_head = (stdmsg_jobs_head + 1) % STDMSG_JOBS_SIZE;
+		stdmsg_jobs_len--;
+		pthread_mutex_unlock(&stdmsg_jobs_mutex);
+		stdmsg_handle(message);
+		pthread_mutex_lock(&stdmsg_jobs_mutex);
+	}
+	pthread_mutex_unlock(&stdmsg_jobs_mutex);
+	return NULL;
+}
+
+static bool stdmsg_jobs_add(cJSON *message) {
+	bool ret = false;
+	pthread_mutex_lock(&stdmsg_jobs_mutex);
+	if (stdmsg_workers_len != 0 && stdmsg_jobs_len != STDMSG_JOBS_SIZE) {
+		stdmsg_jobs[(stdmsg_jobs_head + stdmsg_jobs_len) % STDMSG_JOBS_SIZE] = message;
+		stdmsg_jobs_len++;
+		pthread_cond_signal(&stdmsg_jobs_cond);
+		ret = true;
+	}
+	pthread_mutex_unlock(&stdmsg_jobs_mutex);
+	return ret;
+}
+
+static bool stdmsg_is_slow(const char *action) {
+	// actions that may take a while - these shouldn't hold up the others
+	return strcmp(action, "listPorts") == 0 || strcmp(action, "captureStop") == 0 || strcmp(action, "replayStop") == 0;
+}
+
+static void stdmsg_parse(const char *json, uint32_t len) {
+	cJSON *message = cJSON_ParseWithLength(json, len);
+	if (message == NULL)
+		goto error;
+	const char *action = cJSON_GetStringValue(cJSON_GetObjectItem(message, "action"));
+	if (action == NULL || cJSON_GetObjectItem(message, "id") == NULL)
+		goto error;
+
+	// run slow actions on a worker; if the queue is full, run them right here
+	if (stdmsg_is_slow(action) && stdmsg_jobs_add(message))
+		return;
+	stdmsg_handle(message);
+	return;
+
+error:
+	stdmsg_send_error(cJSON_GetStringValue(cJSON_GetObjectItem(message, "id")), 50);
+	cJSON_Delete(message);
+}
+
+static bool stdmsg_read(void *buf, uint32_t len) {
+	uint8_t *data = buf;
+	while (len != 0) {
+		size_t read = fread(data, sizeof(char), len, stdin);
+		if (read == 0) {
+			// retry if interrupted, give up on EOF
+			if (ferror(stdin) && errno == EINTR) {
+				clearerr(stdin);
+				continue;
+			}
+			return false;
+		}
+		data += read;
+		len -= read;
+	}
+	return true;
+}
+
 int stdmsg_receive() {
+	// kept between messages, only grows if a message doesn't fit
+	static char *json		  = NULL;
+	static uint32_t json_size = 0;
+
 	uint32_t len = 0;
-	fread((void *)&len, sizeof(uint32_t), 1, stdin);
-	if (len == 0)
+	if (!stdmsg_read(&len, sizeof(uint32_t)))
 		return 0;
-	if (len > 4096)
-		return -1;
 
-	char *json = malloc(len + 1);
-	if (json == NULL)
-		return -2;
-	fread(json, sizeof(char), len, stdin);
-	json[len] = '\0';
+	if (len > json_size) {
+		char *buf = realloc(json, len);
+		if (buf == NULL) {
+			// skip the message, as there's no way to read its ID
+			char skip[256];
+			for (uint32_t i = 0; i < len; i += sizeof(skip)) {
+				if (!stdmsg_read(skip, len - i < sizeof(skip) ? len - i : sizeof(skip)))
+					return 0;
+			}
+			stdmsg_send_error(NULL, 52);
+			return sizeof(uint32_t) + len;
+		}
+		json	  = buf;
+		json_size = len;
+	}
+	if (!stdmsg_read(json, len))
+		return 0;
 
-	stdmsg_parse(json);
-	free(json);
-	return len;
+	stdmsg_parse(json, len);
+	return sizeof(uint32_t) + len;
 }
@@ -4,7 +4,35 @@
 
 #include "include.h"
 
+// number of messages that can wait for the writer thread
+#define STDMSG_RING_SLOTS 256
+// maximum size of a queued message; bigger ones are written directly
+#define STDMSG_SLOT_SIZE  1024
+// number of threads running slow actions, like listPorts
+#define STDMSG_WORKERS	  2
+// number of slow actions that can wait for a worker
+#define STDMSG_JOBS_SIZE  16
+// size of the stdout buffer, flushed once per batch of messages
+#define STDMSG_BATCH_SIZE (64 * 1024)
+
+typedef enum {
+	STDMSG_ERROR = 0,
+	STDMSG_WARN	 = 1,
+	STDMSG_INFO	 = 2,
+	STDMSG_DEBUG = 3,
+} stdmsg_level_t;
+
+void stdmsg_start();
+void stdmsg_flush();
+void stdmsg_set_log_level(stdmsg_level_t level);
+uint32_t stdmsg_get_dropped();
+
+json_writer_t *stdmsg_begin(const char *id);
+bool stdmsg_end(json_writer_t *writer);
+int stdmsg_send_log_v(stdmsg_level_t level, const char *fmt, va_list argv);
 void stdmsg_send_log(const char *fmt, ...);
+void stdmsg_send_debug(const char *fmt, ...);
 void stdmsg_send_json(const char *id, cJSON *data);
 void stdmsg_send_error(const char *id, int error);
+void stdmsg_send_event(const char *event, cJSON *data);
 int stdmsg_receive();
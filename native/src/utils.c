@@ -0,0 +1,32 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#include "utils.h"
+
+#include <time.h>
+
+uint64_t utils_time_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool utils_thread_create(pthread_t *thread, void *(*func)(void *), void *arg) {
+	pthread_attr_t attr;
+	if (pthread_attr_init(&attr) != 0)
+		return false;
+	// the default stack is 8 MiB on Linux - way too much for a port's thread
+	pthread_attr_setstacksize(&attr, SERIAL_THREAD_STACK_SIZE);
+	int ret = pthread_create(thread, &attr, func, arg);
+	pthread_attr_destroy(&attr);
+	return ret == 0;
+}
+
+bool utils_cond_wait_us(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t timeout_us) {
+	// macOS can't use CLOCK_MONOTONIC for condition variables
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t nsec = ts.tv_nsec + (timeout_us % 1000000) * 1000;
+	ts.tv_sec += timeout_us / 1000000 + nsec / 1000000000;
+	ts.tv_nsec = nsec % 1000000000;
+	return pthread_cond_timedwait(cond, mutex, &ts) == 0;
+}
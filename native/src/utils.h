@@ -0,0 +1,9 @@
+/* Copyright (c) Kuba Szczodrzyński 2026-10-17. */
+
+#pragma once
+
+#include "include.h"
+
+uint64_t utils_time_us();
+bool utils_thread_create(pthread_t *thread, void *(*func)(void *), void *arg);
+bool utils_cond_wait_us(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t timeout_us);
@@ -3,5 +3,5 @@
 #pragma once
 
 #define NATIVE_VERSION	"0.5.0"
-#define NATIVE_PROTOCOL 2
+#define NATIVE_PROTOCOL 3
 #define WEBSOCKET_PORT	23290
@@ -2,11 +2,7 @@
 
 #include "websocket.h"
 
-#define WS_RESPONSE(opc)                                  \
-	do {                                                  \
-		ws_message_opcode_t opcode = opc;                 \
-		ws_sendframe_bin(conn, (const char *)&opcode, 1); \
-	} while (0)
+#define WS_RESPONSE(opc) websocket_send_response(conn, seq, opc, NULL, 0)
 
 void websocket_start() {
 	struct ws_events evs;
@@ -24,40 +20,92 @@ void websocket_on_open(ws_cli_conn_t *conn) {
 void websocket_on_close(ws_cli_conn_t *conn) {
 	stdmsg_send_log("WS connection closed");
 	serial_port_t *serial = serial_get_by_conn(conn);
-	if (serial != NULL)
-		serial_close(serial);
+	if (serial == NULL) {
+		// only reading, nothing else to clean up
+		serial_unsubscribe(conn);
+		return;
+	}
+	// keep it open for a while, if the page wants to resume it
+	if (serial_resume_detach(serial))
+		return;
+	SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_CLOSE, NULL, 0, utils_time_us());
+	serial_close(serial);
 }
 
-static void websocket_send_error(ws_message_opcode_t code, ws_cli_conn_t *conn) {
-	char *error_msg;
-error:
-	error_msg = sp_last_error_message();
-	if (error_msg == NULL) {
-		WS_RESPONSE(code);
-	} else {
-		int error_len		   = strlen(error_msg);
-		unsigned char *message = malloc(1 + error_len + 1);
-		if (message == NULL) {
-			WS_RESPONSE(code);
-			return;
-		}
-		message[0] = code;
-		strcpy(&message[1], error_msg);
-		ws_sendframe_bin(conn, (const char *)message, 1 + error_len);
-		free(message);
+static void websocket_send_response(
+	ws_cli_conn_t *conn,
+	uint16_t seq,
+	ws_message_opcode_t code,
+	const void *data,
+	uint32_t data_len
+) {
+	uint8_t message[sizeof(ws_header_t) + WS_RESPONSE_MAX];
+	ws_header_t *header = (ws_header_t *)message;
+	header->opcode		= code;
+	header->seq			= seq;
+	if (data_len > WS_RESPONSE_MAX)
+		data_len = WS_RESPONSE_MAX;
+	if (data_len != 0)
+		memcpy(message + sizeof(ws_header_t), data, data_len);
+	ws_sendframe_bin(conn, (const char *)message, sizeof(ws_header_t) + data_len);
+}
+
+static void websocket_send_message(ws_message_opcode_t code, ws_cli_conn_t *conn, uint16_t seq, const char *error_msg) {
+	websocket_send_response(conn, seq, code, error_msg, error_msg != NULL ? strlen(error_msg) : 0);
+}
+
+static void websocket_send_error(ws_message_opcode_t code, ws_cli_conn_t *conn, uint16_t seq) {
+	char *error_msg = sp_last_error_message();
+	websocket_send_message(code, conn, seq, error_msg);
+	if (error_msg != NULL)
 		sp_free_error_message(error_msg);
+}
+
+static void websocket_send_tx_error(serial_port_t *serial, ws_cli_conn_t *conn, uint16_t seq) {
+	// reported by the writer thread, as sp_last_error_message() is only valid there
+	char *error_msg = serial_tx_get_error(serial);
+	websocket_send_message(WSM_ERROR, conn, seq, error_msg);
+	free(error_msg);
+}
+
+static void websocket_send_stats(serial_port_t *serial, ws_cli_conn_t *conn, uint16_t seq) {
+	json_writer_t *writer = json_writer_begin();
+	if (writer == NULL) {
+		websocket_send_message(WSM_ERROR, conn, seq, "Stats unavailable");
+		return;
+	}
+	serial_stats_write(writer, serial);
+	uint32_t len = json_writer_end(writer);
+	if (len == 0) {
+		websocket_send_message(WSM_ERROR, conn, seq, "Stats unavailable");
+		return;
 	}
+	// too long for websocket_send_response() - put the header over the length prefix instead
+	ws_header_t *header = (ws_header_t *)(writer->buf + sizeof(uint32_t) - sizeof(ws_header_t));
+	header->opcode		= WSM_OK;
+	header->seq			= seq;
+	ws_sendframe_bin(conn, (const char *)header, len - sizeof(uint32_t) + sizeof(ws_header_t));
+}
+
+static enum sp_return websocket_drain(serial_port_t *serial) {
+	uint64_t start	   = utils_time_us();
+	enum sp_return ret = sp_drain(serial->port);
+	SERIAL_STATS_ADD(serial, drain_blocked_us, utils_time_us() - start);
+	return ret;
 }
 
 void websocket_on_message(ws_cli_conn_t *conn, const unsigned char *msg, uint64_t msg_len, int msg_type) {
-	if (msg_len < 1)
+	// can't even respond without the header
+	if (msg_len < sizeof(ws_header_t))
 		return;
-	uint8_t opcode	   = msg[0];
-	ws_message_t *data = (ws_message_t *)(msg + 1);
-	int data_len	   = msg_len - 1;
+	ws_header_t *header = (ws_header_t *)msg;
+	uint8_t opcode		= header->opcode;
+	uint16_t seq		= header->seq;
+	ws_message_t *data	= (ws_message_t *)(msg + sizeof(ws_header_t));
+	int data_len		= msg_len - sizeof(ws_header_t);
 
 	serial_port_t *serial = NULL;
-	if (opcode == WSM_PORT_OPEN) {
+	if (opcode == WSM_PORT_OPEN || opcode == WSM_PORT_SUBSCRIBE || opcode == WSM_PORT_RESUME) {
 		// check auth_key string bounds
 		if (memchr(&data->auth_key, '\0', data_len) == NULL) {
 			WS_RESPONSE(WSM_ERR_AUTH);
@@ -68,14 +116,41 @@ void websocket_on_message(ws_cli_conn_t *conn, const unsigned char *msg, uint64_
 			WS_RESPONSE(WSM_ERR_AUTH);
 			return;
 		}
-		// make sure it's closed
-		if (serial->port != NULL) {
-			WS_RESPONSE(WSM_ERR_IS_OPEN);
+		// a port waiting to be resumed is closed first, the page doesn't want it anymore
+		if (opcode == WSM_PORT_OPEN)
+			serial_resume_cancel(serial);
+		// there has to be something to resume
+		if (opcode == WSM_PORT_RESUME && !serial->resume.detached) {
+			serial_stats_error(serial, opcode);
+			WS_RESPONSE(WSM_ERR_NOT_OPEN);
 			return;
 		}
+		// subscribers need it open, in shared mode, and have nothing else open
+		if (opcode == WSM_PORT_SUBSCRIBE) {
+			if (serial->port == NULL) {
+				serial_stats_error(serial, opcode);
+				WS_RESPONSE(WSM_ERR_NOT_OPEN);
+				return;
+			}
+			if (!serial->subscribers.shared || serial_get_by_conn(conn) != NULL ||
+				serial_get_by_subscriber(conn) != NULL) {
+				serial_stats_error(serial, opcode);
+				WS_RESPONSE(WSM_ERR_IS_OPEN);
+				return;
+			}
+		}
 	} else {
 		// find object by WS connection
 		if ((serial = serial_get_by_conn(conn)) == NULL) {
+			// subscribers only read the port - they can leave, or look at the stats
+			if (opcode == WSM_PORT_CLOSE && serial_unsubscribe(conn) != NULL) {
+				WS_RESPONSE(WSM_OK);
+				return;
+			}
+			if (opcode == WSM_GET_STATS && (serial = serial_get_by_subscriber(conn)) != NULL) {
+				websocket_send_stats(serial, conn, seq);
+				return;
+			}
 			WS_RESPONSE(WSM_ERR_NOT_OPEN);
 			return;
 		}
@@ -86,34 +161,148 @@ void websocket_on_message(ws_cli_conn_t *conn, const unsigned char *msg, uint64_
 				WS_RESPONSE(WSM_OK);
 				return;
 			}
+			serial_stats_error(serial, opcode);
 			WS_RESPONSE(WSM_ERR_NOT_OPEN);
 			return;
 		}
 	}
 
 	switch (opcode) {
-		case WSM_PORT_OPEN:
-			if (!serial_open(serial, conn)) {
-				serial_close(serial);
+		case WSM_PORT_OPEN: {
+			// the RX ring size, framing and RX options may follow the auth key
+			uint32_t rx_size = 0;
+			uint32_t key_len = strlen(data->auth_key) + 1;
+			if (data_len >= key_len + sizeof(rx_size))
+				memcpy(&rx_size, data->auth_key + key_len, sizeof(rx_size));
+			ws_framing_t ws_framing = {.mode = SERIAL_FRAMING_NONE};
+			if (data_len >= key_len + sizeof(rx_size) + sizeof(ws_framing))
+				memcpy(&ws_framing, data->auth_key + key_len + sizeof(rx_size), sizeof(ws_framing));
+			uint8_t rx_flags = 0;
+			if (data_len >= key_len + sizeof(rx_size) + sizeof(ws_framing) + sizeof(rx_flags))
+				rx_flags = data->auth_key[key_len + sizeof(rx_size) + sizeof(ws_framing)];
+			uint32_t resume_ms = 0;
+			if (data_len >= key_len + sizeof(rx_size) + sizeof(ws_framing) + sizeof(rx_flags) + sizeof(resume_ms))
+				memcpy(
+					&resume_ms,
+					data->auth_key + key_len + sizeof(rx_size) + sizeof(ws_framing) + sizeof(rx_flags),
+					sizeof(resume_ms)
+				);
+			serial_framing_t framing = {
+				.mode		   = ws_framing.mode,
+				.delimiter_len = ws_framing.delimiter_len,
+				.max_frame	   = ws_framing.max_frame,
+				.record_len	   = ws_framing.record_len,
+				.gap_us		   = ws_framing.gap_us,
+			};
+			memcpy(framing.delimiter, ws_framing.delimiter, sizeof(framing.delimiter));
+			if (framing.mode > SERIAL_FRAMING_FIXED ||
+				(framing.mode == SERIAL_FRAMING_DELIMITER &&
+				 (framing.delimiter_len == 0 || framing.delimiter_len > SERIAL_FRAMING_DELIM_MAX)) ||
+				(framing.mode == SERIAL_FRAMING_FIXED && framing.record_len == 0)) {
+				serial_stats_error(serial, opcode);
+				websocket_send_message(WSM_ERROR, conn, seq, "Invalid framing");
+				return;
+			}
+			// make sure it's closed - checked along with opening, as another connection may be doing it too
+			enum sp_return ret = serial_open(serial, conn, rx_size, rx_flags, &framing);
+			if (ret == SP_ERR_ARG) {
+				serial_stats_error(serial, opcode);
+				WS_RESPONSE(WSM_ERR_IS_OPEN);
+				return;
+			}
+			if (ret != SP_OK)
 				goto error;
+			SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_OPEN, NULL, 0, utils_time_us());
+			if (resume_ms != 0) {
+				// the page presents the token to get the port back, after reconnecting
+				if (!serial_resume_enable(serial, resume_ms)) {
+					serial_close(serial);
+					goto error;
+				}
+				const char *token = serial->resume.token;
+				websocket_send_response(conn, seq, WSM_OK, token, strlen(token) + 1);
+				return;
+			}
+			break;
+		}
+
+		case WSM_PORT_RESUME: {
+			// the token follows the auth key
+			const char *token = data->auth_key + strlen(data->auth_key) + 1;
+			if (memchr(token, '\0', data_len - (token - data->auth_key)) == NULL ||
+				!serial_resume_attach(serial, conn, token)) {
+				serial_stats_error(serial, opcode);
+				WS_RESPONSE(WSM_ERR_AUTH);
+				return;
+			}
+			stdmsg_send_log("Port %s resumed", serial->port_name);
+			break;
+		}
+
+		case WSM_PORT_SUBSCRIBE:
+			if (!serial_subscribe(serial, conn)) {
+				serial_stats_error(serial, opcode);
+				if (atomic_load(&serial->subscribers.len) < SERIAL_SUBSCRIBERS_MAX) {
+					// closed in the meantime
+					WS_RESPONSE(WSM_ERR_NOT_OPEN);
+					return;
+				}
+				websocket_send_message(WSM_ERROR, conn, seq, "Too many subscribers");
+				return;
 			}
 			break;
 
 		case WSM_PORT_CLOSE:
+			// whatever the page has queued is dropped - a stalled line would keep the port open forever
+			SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_CLOSE, NULL, 0, utils_time_us());
 			// try to close the port
 			if (!serial_close(serial))
 				goto error;
 			break;
 
-		case WSM_SET_CONFIG:
-			if (sp_set_baudrate(serial->port, data->baudrate) != SP_OK)
-				goto error;
-			if (sp_set_bits(serial->port, data->data_bits) != SP_OK)
+		case WSM_SET_CONFIG: {
+			bool has_options	   = data_len >= offsetof(ws_message_t, rt_cpu) + sizeof(data->rt_cpu);
+			bool has_flow		   = data_len >= offsetof(ws_message_t, tx_buffer) + sizeof(data->tx_buffer);
+			serial_config_t config = {
+				.baudrate	  = data->baudrate,
+				.data_bits	  = data->data_bits,
+				.parity		  = data->parity,
+				.stop_bits	  = data->stop_bits,
+				.flow_control = has_flow ? data->flow_control : -1,
+				.tx_buffer	  = has_flow ? data->tx_buffer : 0,
+				.low_latency  = has_options ? data->low_latency : 0,
+				.rt_priority  = has_options ? data->rt_priority : 0,
+				.rt_cpu		  = has_options ? data->rt_cpu : 0,
+			};
+			uint8_t applied;
+			enum sp_return ret = serial_set_config(serial, &config, &applied);
+			if (ret == SP_ERR_SUPP) {
+				serial_stats_error(serial, opcode);
+				websocket_send_message(WSM_ERROR, conn, seq, "Unsupported baud rate");
+				return;
+			}
+			if (ret != SP_OK)
 				goto error;
-			if (sp_set_parity(serial->port, data->parity) != SP_OK)
+			SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_CONFIG, data, data_len, utils_time_us());
+			if (!has_options)
+				break;
+			// tell the page which of the options took effect
+			websocket_send_response(conn, seq, WSM_OK, &applied, sizeof(applied));
+			return;
+		}
+
+		case WSM_SET_COALESCE:
+			if (data_len < offsetof(ws_message_t, deadline_us) + sizeof(data->deadline_us))
 				goto error;
-			if (sp_set_stopbits(serial->port, data->stop_bits) != SP_OK)
+			serial_set_coalesce(serial, data->threshold, data->deadline_us);
+			break;
+
+		case WSM_SET_RX_FLOW:
+			if (data_len < sizeof(data->credits))
 				goto error;
+			serial_set_rx_flow(serial, data->credits);
+			// the page reads again, after resuming the port
+			serial_rx_hold(serial, false);
 			break;
 
 		case WSM_SET_SIGNALS:
@@ -121,42 +310,106 @@ void websocket_on_message(ws_cli_conn_t *conn, const unsigned char *msg, uint64_
 				goto error;
 			if (sp_set_rts(serial->port, data->rts) != SP_OK)
 				goto error;
+			SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_SIGNALS, data, 2, utils_time_us());
 			break;
 
 		case WSM_GET_SIGNALS: {
 			enum sp_signal signals;
 			if (sp_get_signals(serial->port, &signals) != SP_OK)
 				goto error;
-			uint8_t response[2] = {WSM_OK, signals};
-			ws_sendframe_bin(conn, (const char *)&response, 2);
+			uint8_t response = signals;
+			websocket_send_response(conn, seq, WSM_OK, &response, sizeof(response));
+			return;
+		}
+
+		case WSM_WATCH_SIGNALS:
+			// pushed with WSM_SIGNALS_CHANGED from now on, instead of polling WSM_GET_SIGNALS
+			if (data_len < sizeof(data->signal_mask) || !serial_signals_watch(serial, data->signal_mask))
+				goto error;
 			break;
+
+		case WSM_RUN_SEQUENCE: {
+			// one round trip, timed natively - the steps are as close together as the port allows
+			uint32_t timings[SERIAL_SEQ_STEPS_MAX];
+			uint8_t count;
+			enum sp_return ret = serial_sequence_run(serial, (const uint8_t *)data, data_len, timings, &count);
+			if (ret == SP_ERR_ARG) {
+				serial_stats_error(serial, opcode);
+				websocket_send_message(WSM_ERROR, conn, seq, "Invalid sequence");
+				return;
+			}
+			if (ret == SP_ERR_SUPP) {
+				serial_stats_error(serial, opcode);
+				websocket_send_message(WSM_ERROR, conn, seq, "Unsupported baud rate");
+				return;
+			}
+			if (ret != SP_OK) {
+				// the writer's error, if it was draining
+				char *error_msg = serial_tx_get_error(serial);
+				if (error_msg == NULL)
+					goto error;
+				serial_stats_error(serial, opcode);
+				websocket_send_message(WSM_ERROR, conn, seq, error_msg);
+				free(error_msg);
+				return;
+			}
+			// when each step was done, since the sequence started
+			websocket_send_response(conn, seq, WSM_OK, timings, count * sizeof(*timings));
+			return;
 		}
 
 		case WSM_START_BREAK:
 			if (sp_start_break(serial->port) != SP_OK)
 				goto error;
+			SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_BREAK, &(uint8_t){1}, 1, utils_time_us());
 			break;
 
 		case WSM_END_BREAK:
 			if (sp_end_break(serial->port) != SP_OK)
 				goto error;
+			SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_BREAK, &(uint8_t){0}, 1, utils_time_us());
 			break;
 
-		case WSM_DATA:
-			if (sp_blocking_write(serial->port, data->data, data_len - 1, 0) < 0)
+		case WSM_DATA: {
+			// at least the drain flag
+			if (data_len < sizeof(data->drain))
 				goto error;
+			SERIAL_STATS_ADD(serial, tx_frames, 1);
+			SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_TX, data->data, data_len - 1, utils_time_us());
+			if (!serial_tx_enqueue(serial, data->data, data_len - 1))
+				goto tx_error;
 			if (data->drain) {
-				if (sp_drain(serial->port) != SP_OK)
+				if (!serial_tx_flush(serial))
+					goto tx_error;
+				if (websocket_drain(serial) != SP_OK)
 					goto error;
 			}
-			break;
+			// acknowledge right away, telling the page how much more it can send
+			uint32_t credits = serial_tx_get_credits(serial);
+			websocket_send_response(conn, seq, WSM_OK, &credits, sizeof(credits));
+			return;
+		}
 
 		case WSM_DRAIN:
-			if (sp_drain(serial->port) != SP_OK)
+			if (!serial_tx_flush(serial))
+				goto tx_error;
+			if (websocket_drain(serial) != SP_OK)
+				goto error;
+			break;
+
+		case WSM_RX_CREDIT:
+			if (data_len < sizeof(data->credits))
 				goto error;
+			serial_add_rx_credits(serial, data->credits);
+			serial_rx_hold(serial, false);
 			break;
 
+		case WSM_GET_STATS:
+			websocket_send_stats(serial, conn, seq);
+			return;
+
 		default:
+			serial_stats_error(serial, opcode);
 			WS_RESPONSE(WSM_ERR_OPCODE);
 			return;
 	}
@@ -164,37 +417,93 @@ void websocket_on_message(ws_cli_conn_t *conn, const unsigned char *msg, uint64_
 	WS_RESPONSE(WSM_OK);
 	return;
 error:
-	websocket_send_error(WSM_ERROR, conn);
+	serial_stats_error(serial, opcode);
+	websocket_send_error(WSM_ERROR, conn, seq);
+	return;
+tx_error:
+	serial_stats_error(serial, opcode);
+	websocket_send_tx_error(serial, conn, seq);
+}
+
+bool websocket_serial_can_read(serial_port_t *serial) {
+	if (!serial_rx_has_space(serial))
+		return false;
+	return !serial->rx_flow || atomic_load(&serial->rx_credits) != 0;
+}
+
+bool websocket_serial_read(serial_port_t *serial, uint64_t time_us) {
+	uint8_t *data;
+	uint32_t space = serial_rx_reserve(serial, &data);
+	if (serial->rx_flow) {
+		// don't take more from the port than the page can accept
+		uint32_t credits = atomic_load(&serial->rx_credits);
+		if (space > credits)
+			space = credits;
+	}
+	if (space == 0)
+		return true;
+	int read = sp_nonblocking_read(serial->port, data, space);
+	if (read < 0)
+		return false;
+	serial_stats_read(serial, read);
+	if (read == 0)
+		return true;
+	if (serial->rx_flow)
+		atomic_fetch_sub(&serial->rx_credits, read);
+	SERIAL_CAPTURE_ADD(serial, SERIAL_CAPTURE_RX, data, read, time_us);
+	// the sender thread takes it from here
+	serial_rx_commit(serial, read, time_us);
+	return true;
+}
+
+void websocket_serial_error(serial_port_t *serial) {
+	// read once, the port may be detached meanwhile
+	ws_cli_conn_t *conn = serial->conn;
+	if (conn != NULL)
+		websocket_send_error(WSM_ERR_READER, conn, 0);
 }
 
 void *websocket_serial_thread(void *arg) {
-	stdmsg_send_log("WS thread running");
+	stdmsg_send_debug("WS thread running");
 
-	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+	// stopped by serial_close(), which interrupts the waits below and joins it
 	serial_port_t *serial = arg;
-	uint8_t buf[4096 + 1];
-	buf[0] = WSM_DATA;
 
 	while (1) {
-		struct sp_port *port = serial->port;
-		if (port == NULL)
-			goto error;
-		if (sp_wait(serial->event_set, 1000) != SP_OK)
-			goto error;
-		int read = sp_nonblocking_read(port, buf + 1, sizeof(buf) - 1);
-		if (read == 0)
-			continue;
-		if (read < 0)
-			goto error;
-		if (serial->conn == NULL)
+		// the platform's wake handle interrupts it, the timeout only matters if there's none
+		unsigned int timeout = 1000;
+		bool waited			 = false;
+		if (!websocket_serial_can_read(serial)) {
+			// out of credits or ring space - leave the data in the port (and its flow control) until there's room
+			pthread_mutex_lock(&serial->rx_mutex);
+			if (!websocket_serial_can_read(serial) && !atomic_load(&serial->thread_stop))
+				utils_cond_wait_us(&serial->rx_cond, &serial->rx_mutex, timeout * 1000);
+			pthread_mutex_unlock(&serial->rx_mutex);
+		} else {
+			if (sp_wait(serial->event_set, timeout) != SP_OK)
+				goto error;
+			waited = true;
+		}
+		// woken up by serial_close() - the port is going away, even if there is data
+		if (atomic_load(&serial->thread_stop))
 			goto ret;
-		ws_sendframe_bin(serial->conn, buf, read + 1);
+		// when the data arrived, as far as the page is concerned
+		uint64_t time_us  = utils_time_us();
+		uint64_t rx_bytes = atomic_load_explicit(&serial->stats.rx_bytes, memory_order_relaxed);
+		if (!websocket_serial_read(serial, time_us))
+			goto error;
+		if (waited) {
+			// the wait timed out if nothing was read
+			if (atomic_load_explicit(&serial->stats.rx_bytes, memory_order_relaxed) != rx_bytes)
+				SERIAL_STATS_ADD(serial, wait_wakeups, 1);
+			else
+				SERIAL_STATS_ADD(serial, wait_timeouts, 1);
+		}
 	}
 
 error:
-	websocket_send_error(WSM_ERR_READER, serial->conn);
+	websocket_serial_error(serial);
 ret:
-	serial->thread = 0;
-	stdmsg_send_log("WS thread finished");
+	stdmsg_send_debug("WS thread finished");
 	return NULL;
 }
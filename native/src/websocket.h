@@ -7,33 +7,79 @@
 #include "serial.h"
 
 typedef enum {
-	WSM_OK			 = 0,
-	WSM_PORT_OPEN	 = 10,
-	WSM_PORT_CLOSE	 = 11,
-	WSM_SET_CONFIG	 = 20,
-	WSM_SET_SIGNALS	 = 30,
-	WSM_GET_SIGNALS	 = 31,
-	WSM_START_BREAK	 = 40,
-	WSM_END_BREAK	 = 41,
-	WSM_DATA		 = 50,
-	WSM_DRAIN		 = 51,
-	WSM_ERROR		 = 128,
-	WSM_ERR_OPCODE	 = 129,
-	WSM_ERR_AUTH	 = 130,
-	WSM_ERR_IS_OPEN	 = 131,
-	WSM_ERR_NOT_OPEN = 132,
-	WSM_ERR_READER	 = 133,
+	WSM_OK				= 0,
+	WSM_PORT_OPEN		= 10,
+	WSM_PORT_CLOSE		= 11,
+	WSM_PORT_SUBSCRIBE	= 12,
+	WSM_PORT_RESUME		= 13,
+	WSM_SET_CONFIG		= 20,
+	WSM_SET_COALESCE	= 21,
+	WSM_SET_RX_FLOW		= 22,
+	WSM_SET_SIGNALS		= 30,
+	WSM_GET_SIGNALS		= 31,
+	WSM_RUN_SEQUENCE	= 32,
+	WSM_WATCH_SIGNALS	= 33,
+	WSM_START_BREAK		= 40,
+	WSM_END_BREAK		= 41,
+	WSM_DATA			= 50,
+	WSM_DRAIN			= 51,
+	WSM_RX_CREDIT		= 52,
+	WSM_DATA_TS			= 53,
+	WSM_SIGNALS_CHANGED = 54,
+	WSM_GET_STATS		= 60,
+	WSM_ERROR			= 128,
+	WSM_ERR_OPCODE		= 129,
+	WSM_ERR_AUTH		= 130,
+	WSM_ERR_IS_OPEN		= 131,
+	WSM_ERR_NOT_OPEN	= 132,
+	WSM_ERR_READER		= 133,
 } ws_message_opcode_t;
 
+// precedes every request and response, and WSM_ERR_READER (with seq 0);
+// the other unsolicited messages have only the opcode before their payload:
+// - WSM_DATA: the RX data
+// - WSM_DATA_TS: u64 read time (native monotonic, in microseconds), the RX data
+// - WSM_SIGNALS_CHANGED: u8 input signals, u32 transition count of each of them
+typedef struct __attribute__((packed)) {
+	uint8_t opcode;
+	uint16_t seq;
+} ws_header_t;
+
+// max. length of a response payload
+#define WS_RESPONSE_MAX 256
+
+// RX framing of WSM_PORT_OPEN, after the auth key and the RX ring size
+typedef struct __attribute__((packed)) {
+	uint8_t mode;		   // SERIAL_FRAMING_*
+	uint8_t delimiter_len; // with SERIAL_FRAMING_DELIMITER
+	uint8_t delimiter[4];  // SERIAL_FRAMING_DELIM_MAX bytes
+	uint32_t max_frame;	   // longer frames are cut, 0 - default
+	uint32_t record_len;   // with SERIAL_FRAMING_FIXED
+	uint32_t gap_us;	   // with SERIAL_FRAMING_IDLE_GAP, 0 - depending on the baud rate
+} ws_framing_t;
+
 typedef union {
 	char auth_key[1];
 	uint8_t signals;
+	uint8_t signal_mask;
+	uint32_t credits;
 
 	struct __attribute__((packed)) {
 		uint32_t baudrate;
 		uint8_t data_bits;
 		uint8_t parity;
 		uint8_t stop_bits;
+		// optional from here on
+		uint8_t low_latency; // SERIAL_LL_* options
+		uint8_t rt_priority; // SCHED_FIFO priority, with SERIAL_LL_RT_PRIORITY
+		int8_t rt_cpu;		 // CPU number, with SERIAL_LL_CPU_PIN
+		int8_t flow_control; // enum sp_flowcontrol, -1 - leave as is
+		uint32_t tx_buffer;	 // TX queue limit in bytes, 0 - depending on the baud rate
+	};
+
+	struct __attribute__((packed)) {
+		uint32_t threshold;
+		uint32_t deadline_us;
 	};
 
 	struct __attribute__((packed)) {
@@ -51,4 +97,7 @@ void websocket_start();
 void websocket_on_open(ws_cli_conn_t *client);
 void websocket_on_close(ws_cli_conn_t *client);
 void websocket_on_message(ws_cli_conn_t *conn, const unsigned char *msg, uint64_t msg_len, int msg_type);
+bool websocket_serial_read(serial_port_t *serial, uint64_t time_us);
+bool websocket_serial_can_read(serial_port_t *serial);
+void websocket_serial_error(serial_port_t *serial);
 void *websocket_serial_thread(void *arg);
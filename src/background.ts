@@ -68,9 +68,9 @@ class MessageHandler {
 	 * ACCESS:
 	 * - Popup Script
 	 */
-	async listAvailablePorts({ origin, options: _options }: BackgroundRequest) {
+	async listAvailablePorts({ origin, options }: BackgroundRequest) {
 		const originAuth = await readOriginAuth(origin)
-		const ports = await listPortsNative()
+		const ports = await listPortsNative(options?.filters)
 		for (const port of ports) {
 			port.isPaired = port.id in originAuth
 		}
@@ -56,8 +56,17 @@ export async function rejectPromise(id: string, reason?: any): Promise<void> {
 	await sendToBackground({ action: "rejectPromise", id, reason })
 }
 
-export async function listPortsNative(): Promise<SerialPortData[]> {
-	return await sendToNative({ action: "listPorts" })
+export async function listPortsNative(
+	filters?: SerialPortFilter[]
+): Promise<SerialPortData[]> {
+	if (!filters?.length) return await sendToNative({ action: "listPorts" })
+	// Bluetooth service classes aren't known natively, match any Bluetooth port
+	filters = filters.map((filter) =>
+		filter.bluetoothServiceClassId !== undefined
+			? { ...filter, transport: "BLUETOOTH" }
+			: filter
+	)
+	return await sendToNative({ action: "listPorts", filters })
 }
 
 export async function authGrant(port: string): Promise<string> {
@@ -3,14 +3,16 @@ import { clearAuthKeyCache, rejectPromise, resolvePromise } from "."
 import { debugLog, debugRx, debugTx } from "../utils/logging"
 import { NativeParams, NativeRequest } from "../utils/types"
 import { catchIgnore } from "../utils/utils"
+import { notifyPopup } from "./popup"
 import { keepPromise } from "./promises"
 
-const NATIVE_PROTOCOL = 2
+const NATIVE_PROTOCOL = 3
 
 let globalPort: browser.runtime.Port = undefined
 
 type RawNativeResponse = {
 	id?: string
+	event?: "portsChanged"
 	data?: any
 	error?: number
 }
@@ -58,6 +60,12 @@ async function getNativePort(): Promise<browser.runtime.Port> {
 		let isOutdated = false
 
 		newPort.onMessage.addListener(async (message: RawNativeResponse) => {
+			if (message.event) {
+				debugRx("NATIVE", message)
+				await handleNativeEvent(message)
+				return
+			}
+
 			if (!message.id) {
 				if (message.data) debugRx("NATIVE", message.data)
 				return
@@ -84,6 +92,9 @@ async function getNativePort(): Promise<browser.runtime.Port> {
 					return
 				}
 				const wsPort = message.data?.wsPort
+				const clockOffsetUs =
+					message.data?.timeUs -
+					(performance.timeOrigin + performance.now()) * 1000
 				debugLog(
 					"NATIVE",
 					"onMessage",
@@ -94,6 +105,7 @@ async function getNativePort(): Promise<browser.runtime.Port> {
 					version,
 					protocol,
 					wsPort,
+					clockOffsetUs,
 				})
 				resolve(newPort)
 				return
@@ -134,6 +146,19 @@ async function getNativePort(): Promise<browser.runtime.Port> {
 	return globalPort
 }
 
+async function handleNativeEvent(message: RawNativeResponse) {
+	switch (message.event) {
+		case "portsChanged":
+			// let the port chooser update its list
+			await notifyPopup({
+				action: "portsChanged",
+				added: message.data?.added,
+				removed: message.data?.removed,
+			})
+			break
+	}
+}
+
 export async function sendToNative(message: NativeRequest): Promise<any> {
 	const [id, promise]: [string, Promise<any>] = keepPromise()
 	const port = await getNativePort()
@@ -1,5 +1,6 @@
 import { rejectPromise } from "."
 import { PopupRequest } from "../utils/types"
+import { catchIgnore } from "../utils/utils"
 import { keepPromise } from "./promises"
 
 const windows: { [key: number]: string } = {}
@@ -41,3 +42,8 @@ export async function sendToPopup(message: PopupRequest): Promise<any> {
 		throw e
 	}
 }
+
+export async function notifyPopup(message: PopupRequest): Promise<void> {
+	// there might be no popup open at all
+	await catchIgnore(browser.runtime.sendMessage(message))
+}
@@ -2,7 +2,12 @@
 
 import { SerialSink } from "./serial/sink"
 import { SerialSource } from "./serial/source"
-import { SerialOpcode, SerialPortData, SerialTransport } from "./serial/types"
+import {
+	SerialOpcode,
+	SerialPortData,
+	SerialPortStats,
+	SerialTransport,
+} from "./serial/types"
 import { SerialWebSocket } from "./serial/websocket"
 import { pack } from "python-struct"
 import { debugLog } from "./utils/logging"
@@ -16,6 +21,8 @@ export class SerialPort extends EventTarget {
 	private transport_: SerialTransport | null
 	private readable_: ReadableStream<Uint8Array> | null
 	private writable_: WritableStream<Uint8Array> | null
+	// RX window of a resumed port, set once something reads it
+	private rxWindow_: number | null
 
 	private options_: SerialOptions | null
 	private outputSignals_: SerialOutputSignals
@@ -27,6 +34,7 @@ export class SerialPort extends EventTarget {
 		this.transport_ = null
 		this.readable_ = null
 		this.writable_ = null
+		this.rxWindow_ = null
 		this.options_ = null
 		this.outputSignals_ = {
 			dataTerminalReady: false,
@@ -52,13 +60,26 @@ export class SerialPort extends EventTarget {
 		if (this.readable_ !== null) return this.readable_
 		if (this.state_ !== "opened") return null
 		this.readable_ = new ReadableStream<Uint8Array>(
-			new SerialSource(this.transport_, () => {
-				this.readable_ = null
-			}),
+			new SerialSource(
+				this.transport_,
+				() => {
+					this.readable_ = null
+				},
+				this.options_.rxFraming !== undefined
+			),
 			{
 				highWaterMark: this.options_?.bufferSize ?? 255,
 			}
 		)
+		if (this.rxWindow_ !== null) {
+			// the native side holds what it buffered until there's a reader
+			catchIgnore(
+				this.transport_.send(
+					pack("<BI", [SerialOpcode.WSM_SET_RX_FLOW, this.rxWindow_])
+				)
+			)
+			this.rxWindow_ = null
+		}
 		return this.readable_
 	}
 
@@ -131,30 +152,172 @@ export class SerialPort extends EventTarget {
 				this.onTransportDisconnect
 			)
 			await this.transport_.connect()
-			await this.transport_.send(
-				pack(`<B${this.port_.authKey.length + 1}s`, [
-					SerialOpcode.WSM_PORT_OPEN,
-					this.port_.authKey,
-				])
-			)
+
+			if (options.rxTimestamps) {
+				// native times are converted using the offset measured on startup
+				const params = await WebSerialPolyfill.getNativeParams()
+				this.transport_.rxTimestamp = (timeUs, length) => {
+					const nowUs =
+						(performance.timeOrigin + performance.now()) * 1000
+					const arrivedUs = timeUs - (params.clockOffsetUs ?? 0)
+					this.dispatchEvent(
+						new CustomEvent("rxtimestamp", {
+							detail: {
+								timeUs,
+								arrivedUs,
+								latencyUs: nowUs - arrivedUs,
+								length,
+							},
+						})
+					)
+				}
+			}
+
+			if (options.subscribe) {
+				// only reading a port opened by another page, which configures it
+				await this.transport_.send(
+					pack(`<B${this.port_.authKey.length + 1}s`, [
+						SerialOpcode.WSM_PORT_SUBSCRIBE,
+						this.port_.authKey,
+					])
+				)
+				return
+			}
+
+			// take over the port left open before a reload, without reopening it
+			const resumeKey = `webserial-resume:${this.port_.name}`
+			const token = options.resumeGraceMs
+				? sessionStorage.getItem(resumeKey)
+				: null
+			let resumed = false
+			if (token !== null) {
+				resumed = await this.transport_
+					.send(
+						pack(
+							`<B${this.port_.authKey.length + 1}s${
+								token.length + 1
+							}s`,
+							[
+								SerialOpcode.WSM_PORT_RESUME,
+								this.port_.authKey,
+								token,
+							]
+						)
+					)
+					.then(
+						() => true,
+						() => false
+					)
+				if (!resumed) sessionStorage.removeItem(resumeKey)
+			}
+
+			// the native side processes these in order, so there's
+			// no need to wait for each response before sending the next one
+			const requests: Promise<any>[] = []
+			// the native RX buffer size and framing may follow the auth key
+			const framing = options.rxFraming
+			if (!resumed)
+				requests.push(
+					this.transport_
+						.send(
+							pack(
+								`<B${this.port_.authKey.length + 1}sIBB4sIIIBI`,
+								[
+									SerialOpcode.WSM_PORT_OPEN,
+									this.port_.authKey,
+									options.rxRingSize ?? 0,
+									["delimiter", "idleGap", "fixed"].indexOf(
+										framing?.mode
+									) + 1,
+									framing?.delimiter?.length ?? 0,
+									framing?.delimiter ?? "",
+									framing?.maxFrameSize ?? 0,
+									framing?.recordLength ?? 0,
+									framing?.idleGapUs ?? 0,
+									(options.rxTimestamps ? 0b01 : 0) |
+										(options.rxShared ? 0b10 : 0),
+									options.resumeGraceMs ?? 0,
+								]
+							)
+						)
+						.then((response) => {
+							// the resume token, if requested
+							if (response.length > 1)
+								sessionStorage.setItem(
+									resumeKey,
+									new TextDecoder().decode(
+										response.subarray(0, -1)
+									)
+								)
+						})
+				)
 
 			// configure port options
-			await this.transport_.send(
-				pack("<BIBBB", [
-					SerialOpcode.WSM_SET_CONFIG,
-					options.baudRate,
-					options.dataBits,
-					options.parity === "even"
-						? 2
-						: options.parity === "odd"
-						? 1
-						: 0,
-					options.stopBits,
-				])
+			const config = [
+				SerialOpcode.WSM_SET_CONFIG,
+				options.baudRate,
+				options.dataBits,
+				options.parity === "even"
+					? 2
+					: options.parity === "odd"
+					? 1
+					: 0,
+				options.stopBits,
+			]
+			const lowLatency =
+				(options.lowLatency ? 0b0011 : 0) |
+				(options.rtPriority !== undefined ? 0b0100 : 0) |
+				(options.rtCpu !== undefined ? 0b1000 : 0)
+			// the whole line config goes in a single message, applied at once
+			requests.push(
+				this.transport_.send(
+					pack("<BIBBBBBbbI", [
+						...config,
+						lowLatency,
+						options.rtPriority ?? 0,
+						options.rtCpu ?? 0,
+						options.softwareFlowControl
+							? 1
+							: options.flowControl === "hardware"
+							? 2
+							: 0,
+						options.txBufferSize ?? 0,
+					])
+				)
 			)
 
+			// tune RX coalescing, if requested by the page
+			if (
+				options.rxCoalesceBytes !== undefined ||
+				options.rxCoalesceUs !== undefined
+			) {
+				requests.push(
+					this.transport_.send(
+						pack("<BII", [
+							SerialOpcode.WSM_SET_COALESCE,
+							options.rxCoalesceBytes ?? 0,
+							options.rxCoalesceUs ?? 0,
+						])
+					)
+				)
+			}
+
+			// only receive as much as the page reads; keep at least
+			// one native read buffer in flight, so that throughput doesn't suffer
+			const rxWindow = Math.max(options.bufferSize ?? 255, 4096)
+			// a resumed port would send what it buffered right away - wait for a reader
+			if (resumed) this.rxWindow_ = rxWindow
+			else
+				requests.push(
+					this.transport_.send(
+						pack("<BI", [SerialOpcode.WSM_SET_RX_FLOW, rxWindow])
+					)
+				)
+
 			// indicate that the client is ready
-			await this.setSignals({ dataTerminalReady: true })
+			requests.push(this.setSignals({ dataTerminalReady: true }))
+
+			await Promise.all(requests)
 		} catch (e) {
 			// close upon errors during opening, then throw the error
 			await catchIgnore(this.close())
@@ -180,19 +343,27 @@ export class SerialPort extends EventTarget {
 		await Promise.all(promises)
 		this.readable_ = null
 		this.writable_ = null
-
-		// indicate that the client is not ready
-		await catchIgnore(
-			this.setSignals({
-				dataTerminalReady: false,
-				requestToSend: false,
-			})
-		)
-
-		// close & disconnect the port
-		await catchIgnore(
-			this.transport_.send(pack("<B", [SerialOpcode.WSM_PORT_CLOSE]))
-		)
+		this.rxWindow_ = null
+
+		// indicate that the client is not ready, then close & disconnect the port
+		await Promise.all([
+			catchIgnore(
+				this.setSignals({
+					dataTerminalReady: false,
+					requestToSend: false,
+				})
+			),
+			catchIgnore(
+				this.transport_
+					.send(pack("<B", [SerialOpcode.WSM_PORT_CLOSE]))
+					// closed on purpose, nothing to resume
+					.then(() =>
+						sessionStorage.removeItem(
+							`webserial-resume:${this.port_.name}`
+						)
+					)
+			),
+		])
 
 		// remove ondisconnect listener, as it would call close() again
 		this.transport_.removeEventListener(
@@ -219,6 +390,7 @@ export class SerialPort extends EventTarget {
 			break: newBRK,
 		} = signals
 
+		const requests: Promise<any>[] = []
 		if (
 			(newDTR !== undefined && oldDTR !== newDTR) ||
 			(newRTS !== undefined && oldRTS !== newRTS)
@@ -228,31 +400,155 @@ export class SerialPort extends EventTarget {
 				"signals",
 				`DTR: ${newDTR ?? oldDTR}, RTS: ${newRTS ?? oldRTS}`
 			)
-			await this.transport_.send(
-				pack("<BBB", [
-					SerialOpcode.WSM_SET_SIGNALS,
-					newDTR ?? oldDTR,
-					newRTS ?? oldRTS,
-				])
+			requests.push(
+				this.transport_.send(
+					pack("<BBB", [
+						SerialOpcode.WSM_SET_SIGNALS,
+						newDTR ?? oldDTR,
+						newRTS ?? oldRTS,
+					])
+				)
 			)
 		}
 		if (newBRK !== undefined && oldBRK !== newBRK) {
-			await this.transport_.send(
-				pack("<B", [
-					newBRK ?? oldBRK
-						? SerialOpcode.WSM_START_BREAK
-						: SerialOpcode.WSM_END_BREAK,
-				])
+			requests.push(
+				this.transport_.send(
+					pack("<B", [
+						newBRK ?? oldBRK
+							? SerialOpcode.WSM_START_BREAK
+							: SerialOpcode.WSM_END_BREAK,
+					])
+				)
 			)
 		}
-
+		// update the state before sending, so that pipelined calls see it
 		this.outputSignals_ = { ...this.outputSignals_, ...signals }
+		await Promise.all(requests)
+	}
+
+	public async runSequence(steps: SerialSequenceStep[]): Promise<number[]> {
+		// encode all steps into one request, timed natively
+		const parts = steps.map((step) => {
+			switch (step.type) {
+				case "signals":
+					// 2 - leave as is
+					return pack("<BBB", [
+						0,
+						step.dataTerminalReady ?? 2,
+						step.requestToSend ?? 2,
+					])
+				case "break":
+					return pack("<BB", [1, step.state])
+				case "delay":
+					return pack("<BI", [2, Math.round(step.ms * 1000)])
+				case "flush":
+					return pack("<BB", [
+						3,
+						(step.drain ? 0b001 : 0) |
+							(step.input ? 0b010 : 0) |
+							(step.output ? 0b100 : 0),
+					])
+				case "config":
+					return pack("<BIBBB", [
+						4,
+						step.baudRate,
+						step.dataBits ?? 8,
+						step.parity === "even"
+							? 2
+							: step.parity === "odd"
+							? 1
+							: 0,
+						step.stopBits ?? 1,
+					])
+			}
+		})
+		const msg = new Uint8Array(
+			1 + parts.reduce((len, part) => len + part.length, 0)
+		)
+		msg[0] = SerialOpcode.WSM_RUN_SEQUENCE
+		parts.reduce((pos, part) => {
+			msg.set(part, pos)
+			return pos + part.length
+		}, 1)
+
+		const response = await this.transport_.send(msg)
+		for (const step of steps) {
+			if (step.type === "signals")
+				this.outputSignals_ = {
+					...this.outputSignals_,
+					dataTerminalReady:
+						step.dataTerminalReady ??
+						this.outputSignals_.dataTerminalReady,
+					requestToSend:
+						step.requestToSend ?? this.outputSignals_.requestToSend,
+				}
+			else if (step.type === "break")
+				this.outputSignals_ = {
+					...this.outputSignals_,
+					break: step.state,
+				}
+		}
+		// when each step was done, in milliseconds since the sequence started
+		const view = new DataView(
+			response.buffer,
+			response.byteOffset,
+			response.byteLength
+		)
+		return steps.map((_, i) => view.getUint32(i * 4, true) / 1000)
+	}
+
+	public async watchSignals(
+		signals: (keyof SerialInputSignals)[]
+	): Promise<void> {
+		// enum sp_signal bits
+		const bits = {
+			clearToSend: 0b0001,
+			dataSetReady: 0b0010,
+			dataCarrierDetect: 0b0100,
+			ringIndicator: 0b1000,
+		}
+		this.transport_.signalsChanged = (signals, counts) => {
+			this.inputSignals_ = {
+				clearToSend: (signals & bits.clearToSend) != 0,
+				dataSetReady: (signals & bits.dataSetReady) != 0,
+				dataCarrierDetect: (signals & bits.dataCarrierDetect) != 0,
+				ringIndicator: (signals & bits.ringIndicator) != 0,
+			}
+			this.dispatchEvent(
+				new CustomEvent("signalschange", {
+					detail: {
+						...this.inputSignals_,
+						// transitions since watching began, even too short to see
+						counts: {
+							clearToSend: counts[0],
+							dataSetReady: counts[1],
+							dataCarrierDetect: counts[2],
+							ringIndicator: counts[3],
+						},
+					},
+				})
+			)
+		}
+		await this.transport_.send(
+			pack("<BB", [
+				SerialOpcode.WSM_WATCH_SIGNALS,
+				signals.reduce((mask, signal) => mask | bits[signal], 0),
+			])
+		)
 	}
 
 	public async getSignals(): Promise<SerialInputSignals> {
 		return this.inputSignals_
 	}
 
+	public async getStats(): Promise<SerialPortStats> {
+		// counted natively, for as long as the port is known
+		const response = await this.transport_.send(
+			pack("<B", [SerialOpcode.WSM_GET_STATS])
+		)
+		return JSON.parse(new TextDecoder().decode(response))
+	}
+
 	public async forget(): Promise<void> {
 		console.log("Not implemented")
 	}
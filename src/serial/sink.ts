@@ -4,6 +4,11 @@ import { SerialTransport } from "./types"
 
 export class SerialSink implements UnderlyingSink<Uint8Array> {
 	controller: WritableStreamDefaultController = null
+	// free space in the native TX queue, as of the last acknowledgement
+	credits: number = 0
+	// bytes sent, but not acknowledged yet
+	inFlight: number = 0
+	lastWrite: Promise<void> = Promise.resolve()
 
 	public constructor(
 		private transport_: SerialTransport,
@@ -30,23 +35,40 @@ export class SerialSink implements UnderlyingSink<Uint8Array> {
 		chunk: Uint8Array,
 		controller: WritableStreamDefaultController
 	): Promise<void> {
-		try {
-			await this.transport_.sendData(chunk)
-		} catch (e) {
-			debugLog("STREAM", "sink", "write() ERROR", e)
-			controller.error(e)
-			this.onClose_()
-		}
+		// wait for acknowledgements until the chunk fits in the native queue
+		while (this.inFlight != 0 && chunk.length > this.credits)
+			await this.lastWrite
+
+		this.credits -= chunk.length
+		this.inFlight += chunk.length
+		const write = this.transport_
+			.sendData(chunk)
+			.then((credits) => {
+				this.inFlight -= chunk.length
+				// don't count the writes sent after this one
+				this.credits = credits - this.inFlight
+			})
+			.catch((e) => {
+				debugLog("STREAM", "sink", "write() ERROR", e)
+				controller.error(e)
+				this.onClose_()
+			})
+		this.lastWrite = write
+
+		// the native side will block until there's room - wait for it
+		if (this.credits < 0) await write
 	}
 
-	close() {
+	async close() {
 		debugLog("STREAM", "sink", "close()")
+		// let the acknowledged writes finish
+		await this.lastWrite
 		this.transport_.removeEventListener("disconnect", this.onDisconnect)
 		this.onClose_()
 	}
 
-	abort() {
+	async abort() {
 		debugLog("STREAM", "sink", "abort()")
-		this.close()
+		await this.close()
 	}
 }
@@ -8,10 +8,14 @@ export class SerialSource implements UnderlyingSource<Uint8Array> {
 	buffer: Uint8Array = null
 	bufferUsed: number = 0
 	wantData: boolean = false
+	// bytes passed to the controller, but not granted back to the native side yet
+	ungranted: number = 0
 
 	public constructor(
 		private transport_: SerialTransport,
-		private onClose_: () => void
+		private onClose_: () => void,
+		// the native side sends whole frames - keep them apart
+		private framed_: boolean = false
 	) {
 		// @ts-ignore
 		this.type = "bytes"
@@ -32,10 +36,16 @@ export class SerialSource implements UnderlyingSource<Uint8Array> {
 		this.buffer = new Uint8Array(bufferSize)
 		this.bufferUsed = 0
 		this.wantData = false
+		this.ungranted = 0
 
 		this.transport_.sourceFeedData = (data) => {
-			if (this.bufferUsed + data.length >= bufferSize) {
-				// the buffer would overflow
+			if (this.framed_) {
+				this.ungranted += data.length
+				controller.enqueue(data)
+				return
+			}
+			while (this.bufferUsed + data.length >= bufferSize) {
+				// the buffer would overflow (possibly many times, as the native side sends up to its window)
 				const newSize = bufferSize - this.bufferUsed
 				const newData = data.slice(0, newSize)
 				// cut from data whatever fits in the buffer
@@ -46,6 +56,7 @@ export class SerialSource implements UnderlyingSource<Uint8Array> {
 				this.bufferUsed = 0
 				// pass the entire buffer to the controller
 				controller.enqueue(new Uint8Array(this.buffer))
+				this.ungranted += bufferSize
 			}
 			if (data.length > 0) {
 				// the buffer will NOT overflow anymore, whatever's left in 'data' will fit
@@ -58,6 +69,9 @@ export class SerialSource implements UnderlyingSource<Uint8Array> {
 	}
 
 	pull(controller: ReadableStreamController<Uint8Array>) {
+		// the reader took what was enqueued before - let the native side send more
+		this.transport_.grantCredits(this.ungranted)
+		this.ungranted = 0
 		if (this.bufferUsed == 0) {
 			// nothing to read, but the reader is waiting for data
 			this.wantData = true
@@ -67,6 +81,7 @@ export class SerialSource implements UnderlyingSource<Uint8Array> {
 		const newData = this.buffer.slice(0, this.bufferUsed)
 		this.bufferUsed = 0
 		// enqueue after consume, since it may unblock and call pull()
+		this.ungranted += newData.length
 		controller.enqueue(newData)
 		this.wantData = false
 	}
@@ -77,6 +92,10 @@ export class SerialSource implements UnderlyingSource<Uint8Array> {
 		this.controller = null
 		this.transport_.removeEventListener("disconnect", this.onDisconnect)
 		this.transport_.sourceFeedData = null
+		// the buffered data is dropped - let the native side send more
+		this.transport_.grantCredits(this.ungranted + this.bufferUsed)
+		this.ungranted = 0
+		this.bufferUsed = 0
 		this.onClose_()
 	}
 }
@@ -19,6 +19,34 @@ export type SerialPortData = {
 	isPaired?: boolean
 }
 
+export type SerialPortStats = {
+	port: string
+	open: boolean
+	rxBytes: number
+	rxFrames: number
+	// frames cut at the maximum frame size
+	rxFramesCut: number
+	// read-only connections of a shared port, and those dropped for being too slow
+	subscribers: number
+	subscribersDropped: number
+	txBytes: number
+	txFrames: number
+	// read() calls by result size: empty, then [2^(n-1), 2^n) bytes
+	readSizes: number[]
+	waitWakeups: number
+	waitTimeouts: number
+	writeBlockedUs: number
+	drainBlockedUs: number
+	// how long the last open and close took
+	openUs: number
+	closeUs: number
+	rxRingSize: number
+	// most bytes ever buffered in the RX ring
+	rxRingHighWater: number
+	// error responses by request opcode
+	errors: { [opcode: string]: number }
+}
+
 export type SerialPortAuth = {
 	[key: string]: {
 		name: string
@@ -29,26 +57,40 @@ export type SerialPortAuth = {
 export interface SerialTransport extends EventTarget {
 	connected: boolean
 	sourceFeedData?: (data: Uint8Array) => void
+	rxTimestamp?: (timeUs: number, length: number) => void
+	signalsChanged?: (signals: number, counts: number[]) => void
 	connect(): Promise<void>
 	disconnect(): Promise<void>
 	send(msg: Uint8Array): Promise<Uint8Array>
-	sendData(data: Uint8Array): Promise<Uint8Array>
+	sendData(data: Uint8Array): Promise<number>
+	grantCredits(credits: number): void
 }
 
 export enum SerialOpcode {
 	WSM_OK = 0,
 	WSM_PORT_OPEN = 10,
 	WSM_PORT_CLOSE = 11,
+	WSM_PORT_SUBSCRIBE = 12,
+	WSM_PORT_RESUME = 13,
 	WSM_SET_CONFIG = 20,
+	WSM_SET_COALESCE = 21,
+	WSM_SET_RX_FLOW = 22,
 	WSM_SET_SIGNALS = 30,
 	WSM_GET_SIGNALS = 31,
+	WSM_RUN_SEQUENCE = 32,
+	WSM_WATCH_SIGNALS = 33,
 	WSM_START_BREAK = 40,
 	WSM_END_BREAK = 41,
 	WSM_DATA = 50,
 	WSM_DRAIN = 51,
+	WSM_RX_CREDIT = 52,
+	WSM_DATA_TS = 53,
+	WSM_SIGNALS_CHANGED = 54,
+	WSM_GET_STATS = 60,
 	WSM_ERROR = 128,
 	WSM_ERR_OPCODE = 129,
 	WSM_ERR_AUTH = 130,
 	WSM_ERR_IS_OPEN = 131,
 	WSM_ERR_NOT_OPEN = 132,
+	WSM_ERR_READER = 133,
 }
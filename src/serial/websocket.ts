@@ -1,14 +1,22 @@
 import { debugLog, debugRx, debugTx } from "../utils/logging"
+import { catchIgnore } from "../utils/utils"
 import { SerialOpcode, SerialTransport } from "./types"
 
+type PendingRequest = {
+	resolve: (value: Uint8Array) => void
+	reject: (reason?: any) => void
+	timeout: ReturnType<typeof setTimeout>
+}
+
 export class SerialWebSocket extends EventTarget implements SerialTransport {
 	private ws_: WebSocket | null = null
 
-	private promise_?: Promise<Uint8Array>
-	private resolve_?: (value: Uint8Array) => void
-	private reject_?: (reason?: any) => void
+	private pending_: Map<number, PendingRequest> = new Map()
+	private seq_: number = 0
 
 	sourceFeedData?: (data: Uint8Array) => void
+	rxTimestamp?: (timeUs: number, length: number) => void
+	signalsChanged?: (signals: number, counts: number[]) => void
 
 	public get connected(): boolean {
 		return this.ws_ !== null && this.ws_.readyState === WebSocket.OPEN
@@ -43,7 +51,7 @@ export class SerialWebSocket extends EventTarget implements SerialTransport {
 	}
 
 	async disconnect(): Promise<void> {
-		if (this.reject_) this.reject_(new Error("Disconnecting"))
+		this.rejectPending(new Error("Disconnecting"))
 		this.dispatchEvent(new Event("disconnect"))
 		if (this.ws_) {
 			debugLog("SOCKET", "state", "Disconnecting socket...")
@@ -54,83 +62,140 @@ export class SerialWebSocket extends EventTarget implements SerialTransport {
 			this.ws_ = null
 			debugLog("SOCKET", "state", "Disconnected socket")
 		}
-		this.clearPromise()
 	}
 
-	private clearPromise() {
-		this.promise_ = null
-		this.resolve_ = null
-		this.reject_ = null
+	private rejectPending(reason: Error) {
+		const pending = this.pending_
+		this.pending_ = new Map()
+		for (const request of pending.values()) {
+			clearTimeout(request.timeout)
+			request.reject(reason)
+		}
+	}
+
+	private nextSeq(): number {
+		// 0 is used by WSM_ERR_READER, which answers no request
+		this.seq_ = (this.seq_ % 0xffff) + 1
+		return this.seq_
 	}
 
 	private async receive(ev: MessageEvent<ArrayBuffer>) {
 		const data = new Uint8Array(ev.data)
 		debugRx("SOCKET", data)
-		if (data[0] == SerialOpcode.WSM_DATA) {
-			if (this.sourceFeedData) this.sourceFeedData(data.subarray(1))
+		if (
+			data[0] == SerialOpcode.WSM_DATA ||
+			data[0] == SerialOpcode.WSM_DATA_TS
+		) {
+			let offset = 1
+			if (data[0] == SerialOpcode.WSM_DATA_TS) {
+				// native monotonic time of the read, before the data
+				const view = new DataView(ev.data)
+				const timeUs = Number(view.getBigUint64(1, true))
+				offset += 8
+				this.rxTimestamp?.(timeUs, data.length - offset)
+			}
+			if (this.sourceFeedData) this.sourceFeedData(data.subarray(offset))
+			// nobody is reading, the data is dropped - let the native side send more
+			else this.grantCredits(data.length - offset)
 			return
 		}
+		if (data[0] == SerialOpcode.WSM_SIGNALS_CHANGED) {
+			// the input signals, then their transition counts
+			const view = new DataView(ev.data)
+			const counts = [0, 1, 2, 3].map((i) =>
+				view.getUint32(2 + i * 4, true)
+			)
+			this.signalsChanged?.(data[1], counts)
+			return
+		}
+		if (data[0] == SerialOpcode.WSM_ERR_READER) {
+			// sent by the reader on its own, not in response to a request
+			await this.disconnect()
+			return
+		}
+
+		// every response carries the sequence number of its request
+		const seq = data[1] | (data[2] << 8)
+		const request = this.pending_.get(seq)
+		if (!request) return
+		this.pending_.delete(seq)
+		clearTimeout(request.timeout)
+
 		if (data[0] >= SerialOpcode.WSM_ERROR) {
-			if (this.reject_) {
-				const decoder = new TextDecoder()
-				let message = `Native error ${data[0]}`
-				switch (data[0]) {
-					case SerialOpcode.WSM_ERR_OPCODE:
-						message = "Invalid operation"
-						break
-					case SerialOpcode.WSM_ERR_AUTH:
-						message = "Port not found (auth)"
-						break
-					case SerialOpcode.WSM_ERR_IS_OPEN:
-						message = "Port is already open"
-						break
-					case SerialOpcode.WSM_ERR_NOT_OPEN:
-						message = "Port is not open"
-						break
-					default:
-						message =
-							decoder.decode(data.subarray(1)) + ` (${data[0]})`
-				}
-				this.reject_(new Error(message))
-			} else {
-				await this.disconnect()
+			const decoder = new TextDecoder()
+			let message = `Native error ${data[0]}`
+			switch (data[0]) {
+				case SerialOpcode.WSM_ERR_OPCODE:
+					message = "Invalid operation"
+					break
+				case SerialOpcode.WSM_ERR_AUTH:
+					message = "Port not found (auth)"
+					break
+				case SerialOpcode.WSM_ERR_IS_OPEN:
+					message = "Port is already open"
+					break
+				case SerialOpcode.WSM_ERR_NOT_OPEN:
+					message = "Port is not open"
+					break
+				default:
+					message =
+						decoder.decode(data.subarray(3)) + ` (${data[0]})`
 			}
-
-			this.clearPromise()
+			request.reject(new Error(message))
 			return
 		}
-		if (this.resolve_) this.resolve_(data)
-		this.clearPromise()
+		request.resolve(data.subarray(3))
 	}
 
 	async send(msg: Uint8Array): Promise<Uint8Array> {
-		if (!this.connected) throw Error("Not connected")
-
-		// await this.promise_
-		this.promise_ = new Promise<Uint8Array>((resolve, reject) => {
-			this.resolve_ = resolve
-			this.reject_ = reject
-			this.ws_.send(msg.buffer)
-			debugTx("SOCKET", msg)
-		})
+		// insert the sequence number after the opcode
+		const frame = new Uint8Array(msg.length + 2)
+		frame[0] = msg[0]
+		frame.set(msg.subarray(1), 3)
+		return await this.sendFrame(frame)
+	}
 
-		const timeout = setTimeout(() => {
-			if (this.reject_)
-				this.reject_(new Error("Timeout waiting for native response"))
-			this.clearPromise()
-		}, 5000)
+	async sendData(data: Uint8Array): Promise<number> {
+		const frame = new Uint8Array(data.length + 4)
+		frame[0] = SerialOpcode.WSM_DATA
+		frame[3] = 0
+		frame.set(data, 4)
+		const response = await this.sendFrame(frame)
+		// the native TX queue's free space
+		if (response.length < 4) return 0
+		return new DataView(
+			response.buffer,
+			response.byteOffset,
+			response.length
+		).getUint32(0, true)
+	}
 
-		const response = await this.promise_
-		clearTimeout(timeout)
-		this.clearPromise()
-		return response
+	grantCredits(credits: number) {
+		if (credits <= 0 || !this.connected) return
+		const frame = new Uint8Array(7)
+		frame[0] = SerialOpcode.WSM_RX_CREDIT
+		new DataView(frame.buffer).setUint32(3, credits, true)
+		catchIgnore(this.sendFrame(frame))
 	}
 
-	async sendData(data: Uint8Array): Promise<Uint8Array> {
-		const msg = new Uint8Array(data.length + 2)
-		msg[0] = SerialOpcode.WSM_DATA
-		msg[1] = 0
-		msg.set(data, 2)
-		return await this.send(msg)
+	private async sendFrame(frame: Uint8Array): Promise<Uint8Array> {
+		if (!this.connected) throw Error("Not connected")
+
+		const seq = this.nextSeq()
+		frame[1] = seq & 0xff
+		frame[2] = seq >> 8
+
+		return await new Promise<Uint8Array>((resolve, reject) => {
+			this.pending_.set(seq, {
+				resolve,
+				reject,
+				timeout: setTimeout(() => {
+					this.pending_.delete(seq)
+					reject(new Error("Timeout waiting for native response"))
+				}, 5000),
+			})
+			this.ws_.send(frame.buffer)
+			debugTx("SOCKET", frame)
+		})
 	}
 }
@@ -1,7 +1,7 @@
 import React from "react"
 import { getNativeParams, listAvailablePorts } from "../../messaging"
 import { SerialPortData } from "../../serial/types"
-import { NativeParams } from "../../utils/types"
+import { NativeParams, PopupRequest } from "../../utils/types"
 import {
 	ButtonContainer,
 	ButtonMessage,
@@ -34,6 +34,7 @@ export class PortChooser extends React.Component<
 		this.state = { params: null, ports: null, active: null }
 		this.handleItemClick = this.handleItemClick.bind(this)
 		this.handleRefresh = this.handleRefresh.bind(this)
+		this.handleMessage = this.handleMessage.bind(this)
 		this.handleOkClick = this.handleOkClick.bind(this)
 		this.handleCancelClick = this.handleCancelClick.bind(this)
 	}
@@ -60,6 +61,26 @@ export class PortChooser extends React.Component<
 		}
 	}
 
+	handleMessage(message: PopupRequest) {
+		if (message.action === "portsChanged") this.handlePortsChanged()
+	}
+
+	async handlePortsChanged() {
+		if (this.state.params?.state !== "connected") return
+		try {
+			const ports = await listAvailablePorts(
+				this.props.origin,
+				this.props.options
+			)
+			// keep the same port selected, if it's still there
+			const activeId = this.state.ports?.[this.state.active]?.id
+			const active = ports.findIndex((port) => port.id === activeId)
+			this.setState({ ports, active: active !== -1 ? active : null })
+		} catch (error) {
+			this.setState({ error })
+		}
+	}
+
 	handleCancelClick() {
 		this.props.reject(new Error("No port selected by the user."))
 	}
@@ -73,9 +94,14 @@ export class PortChooser extends React.Component<
 	}
 
 	componentDidMount() {
+		browser.runtime.onMessage.addListener(this.handleMessage)
 		this.handleRefresh()
 	}
 
+	componentWillUnmount() {
+		browser.runtime.onMessage.removeListener(this.handleMessage)
+	}
+
 	render() {
 		let hostname: string
 		if (this.props.origin) {
@@ -1,3 +1,5 @@
+import { SerialPortData } from "../serial/types"
+
 export type BackgroundRequest = {
 	action:
 		| "getNativeParams"
@@ -19,16 +21,26 @@ export type BackgroundRequest = {
 }
 
 export type NativeRequest = {
-	action?: "ping" | "listPorts" | "authGrant" | "authRevoke"
+	action?:
+		| "ping"
+		| "listPorts"
+		| "authGrant"
+		| "authRevoke"
+		| "stats"
 	id?: string
 	port?: string
+	// listPorts
+	filters?: SerialPortFilter[]
 }
 
 export type PopupRequest = {
-	action?: "choosePort"
+	action?: "choosePort" | "portsChanged"
 	// choosePort
 	origin?: string
 	options?: SerialPortRequestOptions
+	// portsChanged
+	added?: SerialPortData[]
+	removed?: SerialPortData[]
 }
 
 export type NativeParams = {
@@ -38,4 +50,6 @@ export type NativeParams = {
 	version?: string
 	protocol?: number
 	wsPort?: number
+	// native monotonic clock minus the epoch time, in microseconds
+	clockOffsetUs?: number
 }
@@ -1,4 +1,4 @@
-import { SerialPortData } from "./src/serial/types";
+import { SerialPortData, SerialPortStats } from "./src/serial/types";
 import { NativeParams } from "./src/utils/types";
 
 export { }
@@ -17,6 +17,78 @@ declare global {
 
 	const WebSerialPolyfill: WebSerialPolyfill
 
+	// non-standard options supported by the polyfill
+	interface SerialOptions {
+		// send RX data to the page once this many bytes are buffered
+		rxCoalesceBytes?: number
+		// send RX data to the page once the oldest byte is this old (0 - immediately)
+		rxCoalesceUs?: number
+		// capacity of the native RX buffer, in bytes
+		rxRingSize?: number
+		// Linux: ASYNC_LOW_LATENCY and an exact (possibly non-standard) baud rate
+		lowLatency?: boolean
+		// Linux: SCHED_FIFO priority of the native reader thread
+		rtPriority?: number
+		// Linux: CPU to pin the native reader thread to
+		rtCpu?: number
+		// XON/XOFF flow control, instead of flowControl
+		softwareFlowControl?: boolean
+		// how many bytes may be queued natively for writing (default: 250 ms at the baud rate)
+		txBufferSize?: number
+		// dispatch "rxtimestamp" events on the port, with the time the native side read each chunk
+		rxTimestamps?: boolean
+		// let other pages subscribe to the RX data of this port
+		rxShared?: boolean
+		// only read a port opened by another page with rxShared; its RX options apply, and writing fails
+		subscribe?: boolean
+		// keep the port open natively for this long after the page goes away (e.g. reloads);
+		// reopening it from the same tab resumes it, with the data received meanwhile
+		resumeGraceMs?: number
+		// split RX data into frames natively; every read() returns a single frame
+		rxFraming?: {
+			mode: "delimiter" | "idleGap" | "fixed"
+			// up to 4 characters ending a frame, e.g. "\r\n"
+			delimiter?: string
+			// length of every frame, in fixed mode
+			recordLength?: number
+			// pause ending a frame, in idle gap mode (default: 3.5 characters)
+			idleGapUs?: number
+			// longer frames are cut (default: 4096)
+			maxFrameSize?: number
+		}
+	}
+
+	// a step of SerialPort.runSequence()
+	type SerialSequenceStep =
+		| { type: "signals"; dataTerminalReady?: boolean; requestToSend?: boolean }
+		| { type: "break"; state: boolean }
+		// counted from the end of the previous step; at most 2000 ms in total
+		| { type: "delay"; ms: number }
+		// drain: write out the queued data (once per sequence); input/output: discard the port's buffers
+		| { type: "flush"; drain?: boolean; input?: boolean; output?: boolean }
+		| { type: "config"; baudRate: number; dataBits?: number; parity?: ParityType; stopBits?: number }
+
+	// non-standard methods supported by the polyfill
+	interface SerialPort {
+		// run the steps natively, with precise timing (e.g. to enter a bootloader);
+		// resolves with the time each step was done, in ms since the first one started
+		runSequence(steps: SerialSequenceStep[]): Promise<number[]>
+		// dispatch "signalschange" events when any of these input signals changes, instead of polling getSignals();
+		// an empty list stops watching
+		watchSignals(signals: (keyof SerialInputSignals)[]): Promise<void>
+		// hot path counters of the native side, e.g. RX/TX bytes, read sizes and blocked time
+		getStats(): Promise<SerialPortStats>
+	}
+
+	// non-standard port filters supported by the polyfill
+	interface SerialPortFilter {
+		transport?: "NATIVE" | "USB" | "BLUETOOTH"
+		// USB serial number
+		serialNumber?: string
+		// glob pattern of the port name, e.g. "/dev/ttyUSB*"
+		name?: string
+	}
+
 	function cloneInto<T>(obj: T, target: object, options?: object): T
 	function exportFunction<T>(obj: T, target: object): T
 }